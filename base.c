@@ -244,6 +244,7 @@ ctr_object* ctr_object_learn_meaning(ctr_object* myself, ctr_argument* ctr_argum
  * the original return value until the message 'done' has been received.
  */
 ctr_object* ctr_object_do( ctr_object* myself, ctr_argument* argumentList ) {
+	myself = ctr_internal_unshare(myself);
 	myself->info.chainMode = 1;
 	return myself;
 }
@@ -341,6 +342,7 @@ ctr_object* ctr_object_on_do(ctr_object* myself, ctr_argument* argumentList) {
 		CtrStdFlow->info.sticky = 1;
 		return myself;
 	}
+	myself = ctr_internal_unshare(myself);
 	ctr_internal_object_add_property(myself, methodName, methodBlock, 1);
 	return myself;
 }
@@ -491,6 +493,17 @@ ctr_object* ctr_object_is_nil(ctr_object* myself, ctr_argument* argumentList) {
  * False
  */
 ctr_object* ctr_build_bool(int truth) {
+	return (truth) ? CtrStdTrue : CtrStdFalse;
+}
+
+/**
+ * @internal
+ * BuildBoolBox
+ *
+ * Creates a new, private boolean object. ctr_build_bool returns
+ * the shared True and False objects instead.
+ */
+ctr_object* ctr_build_bool_box(int truth) {
 	ctr_object* boolObject = ctr_internal_create_object(CTR_OBJECT_TYPE_OTBOOL);
 	if (truth) boolObject->value.bvalue = 1; else boolObject->value.bvalue = 0;
 	boolObject->info.type = CTR_OBJECT_TYPE_OTBOOL;
@@ -590,10 +603,10 @@ ctr_object* ctr_bool_if_true(ctr_object* myself, ctr_argument* argumentList) {
 	ctr_object* result;
 	if (myself->value.bvalue) {
 		ctr_object* codeBlock = argumentList->object;
-		ctr_argument* arguments = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		arguments->object = myself;
-		result = ctr_block_run(codeBlock, arguments, NULL);
-		ctr_heap_free( arguments );
+		ctr_argument arguments;
+		arguments.object = myself;
+		arguments.next = NULL;
+		result = ctr_block_run(codeBlock, &arguments, NULL);
 		return result;
 	}
 	if (CtrStdFlow == CtrStdBreak) CtrStdFlow = NULL; /* consume break */
@@ -616,10 +629,10 @@ ctr_object* ctr_bool_if_false(ctr_object* myself, ctr_argument* argumentList) {
 	ctr_object* result;
 	if (!myself->value.bvalue) {
 		ctr_object* codeBlock = argumentList->object;
-		ctr_argument* arguments = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		arguments->object = myself;
-		result = ctr_block_run(codeBlock, arguments, NULL);
-		ctr_heap_free( arguments );
+		ctr_argument arguments;
+		arguments.object = myself;
+		arguments.next = NULL;
+		result = ctr_block_run(codeBlock, &arguments, NULL);
 		return result;
 	}
 	if (CtrStdFlow == CtrStdBreak) CtrStdFlow = NULL; /* consume break */
@@ -797,12 +810,152 @@ ctr_object* ctr_build_number_from_string(char* str, ctr_size length) {
  * Internal use only.
  */
 ctr_object* ctr_build_number_from_float(ctr_number f) {
+	ctr_object* numberObject;
+	if (f >= CTR_NUMBER_IMMEDIATE_MIN && f <= CTR_NUMBER_IMMEDIATE_MAX && f == (int) f && !(f == 0 && signbit(f))) {
+		numberObject = ctr_number_immediates[(int) f - CTR_NUMBER_IMMEDIATE_MIN];
+		if (numberObject) return numberObject;
+	}
+	return ctr_build_number_box(f);
+}
+
+/**
+ * @internal
+ * BuildNumberBox
+ *
+ * Creates a new, private number object from a float.
+ * Use this instead of ctr_build_number_from_float if the
+ * number is going to be changed in place.
+ */
+ctr_object* ctr_build_number_box(ctr_number f) {
 	ctr_object* numberObject = ctr_internal_create_object(CTR_OBJECT_TYPE_OTNUMBER);
 	numberObject->value.nvalue = f;
 	numberObject->link = CtrStdNumber;
 	return numberObject;
 }
 
+/**
+ * @internal
+ * InitializeImmediates
+ *
+ * Creates the shared number objects for the small integers.
+ * These are sticky and flagged as shared, messages that change
+ * a number in place (+=: and friends, qualification) will work
+ * on a private copy instead, and collections store a copy.
+ */
+void ctr_number_initialize_immediates() {
+	int i;
+	ctr_object* numberObject;
+	for(i = CTR_NUMBER_IMMEDIATE_MIN; i <= CTR_NUMBER_IMMEDIATE_MAX; i++) {
+		numberObject = ctr_build_number_box((ctr_number) i);
+		numberObject->info.sticky = 1;
+		numberObject->info.shared = 1;
+		ctr_number_immediates[i - CTR_NUMBER_IMMEDIATE_MIN] = numberObject;
+	}
+}
+
+/**
+ * @internal
+ * InitializeOps
+ *
+ * Registers the selectors of the binary messages that have a
+ * fast path, call this after the Number methods have been added.
+ */
+void ctr_number_initialize_ops() {
+	char* names[CTR_NUMBER_OP_COUNT];
+	int i;
+	names[0] = NULL;
+	names[CTR_NUMBER_OP_PLUS] = CTR_DICT_PLUS;
+	names[CTR_NUMBER_OP_MINUS] = CTR_DICT_MINUS;
+	names[CTR_NUMBER_OP_MULTIPLY] = CTR_DICT_MULTIPLIER;
+	names[CTR_NUMBER_OP_DIVIDE] = CTR_DICT_DIVISION;
+	names[CTR_NUMBER_OP_MODULO] = CTR_DICT_MODULO;
+	names[CTR_NUMBER_OP_GREATER] = CTR_DICT_GREATER;
+	names[CTR_NUMBER_OP_GREATER_OR_EQUAL] = CTR_DICT_GREATER_OR_EQUAL_SYMBOL;
+	names[CTR_NUMBER_OP_LESS] = CTR_DICT_LESS;
+	names[CTR_NUMBER_OP_LESS_OR_EQUAL] = CTR_DICT_LESS_OR_EQUAL_SYMBOL;
+	names[CTR_NUMBER_OP_EQUALS] = CTR_DICT_SYMBOL_EQUALS;
+	names[CTR_NUMBER_OP_UNEQUALS] = CTR_DICT_UNEQUALS_SYMBOL;
+	ctr_number_op_selectors[0] = NULL;
+	ctr_number_op_enabled[0] = 0;
+	for(i = 1; i < CTR_NUMBER_OP_COUNT; i++) {
+		ctr_number_op_selectors[i] = ctr_internal_symbol(names[i], strlen(names[i]), 1);
+		ctr_number_op_enabled[i] = 1;
+	}
+}
+
+/**
+ * @internal
+ * NumberOp
+ *
+ * Returns the fast path operation for a selector or 0.
+ */
+uint8_t ctr_number_op(ctr_object* selector) {
+	uint8_t i;
+	for(i = 1; i < CTR_NUMBER_OP_COUNT; i++) {
+		if (ctr_number_op_selectors[i] == selector) return i;
+	}
+	return 0;
+}
+
+/**
+ * @internal
+ * NumberOpInvalidate
+ *
+ * Disables the fast path for a selector, called when the Number
+ * method for that selector is replaced or removed.
+ */
+void ctr_number_op_invalidate(ctr_object* selector) {
+	uint8_t i;
+	if (selector->info.type != CTR_OBJECT_TYPE_OTSTRING) return;
+	if (!selector->info.interned) {
+		selector = ctr_internal_symbol(selector->value.svalue->value, selector->value.svalue->vlen, 0);
+		if (!selector) return;
+	}
+	for(i = 1; i < CTR_NUMBER_OP_COUNT; i++) {
+		if (ctr_number_op_selectors[i] == selector) ctr_number_op_enabled[i] = 0;
+	}
+}
+
+/**
+ * @internal
+ * NumberOpApply
+ *
+ * Computes a binary operation on two plain numbers without sending
+ * a message. Returns NULL if the fast path does not apply (other
+ * operands, redefined method, division by zero, security profiles
+ * that inspect every message), the message has to be sent then.
+ */
+ctr_object* ctr_number_op_apply(uint8_t op, ctr_object* myself, ctr_object* other) {
+	ctr_number a;
+	ctr_number b;
+	if (!ctr_number_op_enabled[op]
+		|| CtrStdFlow
+		|| myself->info.type != CTR_OBJECT_TYPE_OTNUMBER
+		|| other->info.type != CTR_OBJECT_TYPE_OTNUMBER
+		|| myself->link != CtrStdNumber
+		|| myself->methods->size > 0
+		|| myself->info.chainMode
+		|| (ctr_command_security_profile & (CTR_SECPRO_COUNTDOWN | CTR_SECPRO_EVAL))) {
+		return NULL;
+	}
+	a = myself->value.nvalue;
+	b = other->value.nvalue;
+	switch(op) {
+		case CTR_NUMBER_OP_PLUS: return ctr_build_number_from_float(a + b);
+		case CTR_NUMBER_OP_MINUS: return ctr_build_number_from_float(a - b);
+		case CTR_NUMBER_OP_MULTIPLY: return ctr_build_number_from_float(a * b);
+		case CTR_NUMBER_OP_DIVIDE: return (b == 0) ? NULL : ctr_build_number_from_float(a / b);
+		case CTR_NUMBER_OP_MODULO: return (b == 0) ? NULL : ctr_build_number_from_float(fmod(a, b));
+		case CTR_NUMBER_OP_GREATER: return ctr_build_bool(a > b);
+		case CTR_NUMBER_OP_GREATER_OR_EQUAL: return ctr_build_bool(a >= b);
+		case CTR_NUMBER_OP_LESS: return ctr_build_bool(a < b);
+		case CTR_NUMBER_OP_LESS_OR_EQUAL: return ctr_build_bool(a <= b);
+		case CTR_NUMBER_OP_EQUALS: return ctr_build_bool(a == b);
+		case CTR_NUMBER_OP_UNEQUALS: return ctr_build_bool(a != b);
+	}
+	return NULL;
+}
+
 /**
  * [Number] > [other]
  *
@@ -934,6 +1087,7 @@ ctr_object* ctr_number_add(ctr_object* myself, ctr_argument* argumentList) {
  */
 ctr_object* ctr_number_inc(ctr_object* myself, ctr_argument* argumentList) {
 	ctr_object* otherNum = ctr_internal_cast2number(argumentList->object);
+	myself = ctr_internal_unshare(myself);
 	myself->value.nvalue += otherNum->value.nvalue;
 	return myself;
 }
@@ -959,6 +1113,7 @@ ctr_object* ctr_number_minus(ctr_object* myself, ctr_argument* argumentList) {
  */
 ctr_object* ctr_number_dec(ctr_object* myself, ctr_argument* argumentList) {
 	ctr_object* otherNum = ctr_internal_cast2number(argumentList->object);
+	myself = ctr_internal_unshare(myself);
 	myself->value.nvalue -= otherNum->value.nvalue;
 	return myself;
 }
@@ -993,25 +1148,21 @@ ctr_object* ctr_number_multiply(ctr_object* myself, ctr_argument* argumentList)
  * number is passed to the block as a parameter (i in this example).
  */
 ctr_object* ctr_number_times(ctr_object* myself, ctr_argument* argumentList) {
-	ctr_object* indexNumber;
 	ctr_object* block = argumentList->object;
-	ctr_argument* arguments;
+	ctr_block_loop loop;
 	int t;
 	int i;
 	if (block->info.type != CTR_OBJECT_TYPE_OTBLOCK) { printf("Expected code block."); exit(1); }
 	block->info.sticky = 1;
 	t = myself->value.nvalue;
-	arguments = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
+	ctr_block_loop_start(&loop, block, 1);
 	for(i=0; i<t; i++) {
-		indexNumber = ctr_build_number_from_float((ctr_number) i);
-		arguments->object = indexNumber;
-		ctr_block_run(block, arguments, NULL);
+		ctr_block_loop_run(&loop, ctr_block_loop_index(&loop, (ctr_number) i));
 		if (CtrStdFlow == CtrStdContinue) CtrStdFlow = NULL; /* consume continue */
 		if (CtrStdFlow) break;
 	}
-	ctr_heap_free( arguments );
+	ctr_block_loop_end(&loop);
 	if (CtrStdFlow == CtrStdBreak) CtrStdFlow = NULL; /* consume break */
-	block->info.mark = 0;
 	block->info.sticky = 0;
 	return myself;
 }
@@ -1032,6 +1183,7 @@ ctr_object* ctr_number_times(ctr_object* myself, ctr_argument* argumentList) {
  */
 ctr_object* ctr_number_mul(ctr_object* myself, ctr_argument* argumentList) {
 	ctr_object* otherNum = ctr_internal_cast2number(argumentList->object);
+	myself = ctr_internal_unshare(myself);
 	myself->value.nvalue *= otherNum->value.nvalue;
 	return myself;
 }
@@ -1070,6 +1222,7 @@ ctr_object* ctr_number_divide(ctr_object* myself, ctr_argument* argumentList) {
  */
 ctr_object* ctr_number_div(ctr_object* myself, ctr_argument* argumentList) {
 	ctr_object* otherNum = ctr_internal_cast2number(argumentList->object);
+	myself = ctr_internal_unshare(myself);
 	if (otherNum->value.nvalue == 0) {
 		CtrStdFlow = ctr_build_string_from_cstring("Division by zero.");
 		return myself;
@@ -1226,7 +1379,7 @@ ctr_object* ctr_number_to_step_do(ctr_object* myself, ctr_argument* argumentList
 	double incValue   = ctr_internal_cast2number(argumentList->next->object)->value.nvalue;
 	double curValue   = startValue;
 	ctr_object* codeBlock = argumentList->next->next->object;
-	ctr_argument* arguments;
+	ctr_block_loop loop;
 	int forward = 0;
 	if (startValue == endValue) return myself;
 	forward = (startValue < endValue);
@@ -1234,14 +1387,13 @@ ctr_object* ctr_number_to_step_do(ctr_object* myself, ctr_argument* argumentList
 		CtrStdFlow = ctr_build_string_from_cstring("Expected block.");
 		return myself;
 	}
+	ctr_block_loop_start(&loop, codeBlock, 1);
 	while(((forward && curValue <= endValue) || (!forward && curValue >= endValue)) && !CtrStdFlow) {
-		arguments = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		arguments->object = ctr_build_number_from_float(curValue);
-		ctr_block_run(codeBlock, arguments, NULL);
-		ctr_heap_free( arguments );
+		ctr_block_loop_run(&loop, ctr_block_loop_index(&loop, curValue));
 		if (CtrStdFlow == CtrStdContinue) CtrStdFlow = NULL; /* consume continue and go on */
 		curValue += incValue;
 	}
+	ctr_block_loop_end(&loop);
 	if (CtrStdFlow == CtrStdBreak) CtrStdFlow = NULL; /* consume break */
 	return myself;
 }
@@ -1264,6 +1416,7 @@ ctr_object* ctr_number_floor(ctr_object* myself, ctr_argument* argumentList) {
 }
 
 ctr_object* ctr_number_qualify(ctr_object* myself, ctr_argument* argumentList) {
+	myself = ctr_internal_unshare(myself);
 	ctr_internal_object_set_property( myself, ctr_build_string_from_cstring( "qualification" ), ctr_internal_cast2string( argumentList->object ), CTR_CATEGORY_PRIVATE_PROPERTY );
 	return myself;
 }
@@ -1462,6 +1615,47 @@ ctr_object* ctr_build_string(char* stringValue, long size) {
 	return stringObject;
 }
 
+/**
+ * @internal
+ * BuildStringShared
+ *
+ * Creates a string object that shares the bytes of the original
+ * string. The first message that modifies either one of them
+ * gives it its own copy (see ctr_internal_string_unshare).
+ */
+ctr_object* ctr_build_string_shared(ctr_object* original) {
+	ctr_object* stringObject = ctr_internal_create_object(CTR_OBJECT_TYPE_OTSTRING);
+	ctr_heap_free( stringObject->value.svalue );
+	stringObject->value.svalue = original->value.svalue;
+	stringObject->value.svalue->shared++;
+	stringObject->link = CtrStdString;
+	return stringObject;
+}
+
+/**
+ * @internal
+ * StringUnshare
+ *
+ * Gives a string object its own copy of the bytes if it shares
+ * them with other strings. Call this before modifying a string.
+ */
+void ctr_internal_string_unshare(ctr_object* stringObject) {
+	ctr_string* original = stringObject->value.svalue;
+	ctr_string* copy;
+	if (original->shared == 0) return;
+	copy = ctr_heap_allocate( sizeof( ctr_string ) );
+	copy->value = "";
+	copy->vlen = original->vlen;
+	if (original->vlen > 0) {
+		copy->value = ctr_heap_allocate( original->vlen * sizeof(char) );
+		memcpy(copy->value, original->value, original->vlen);
+	}
+	copy->hash = original->hash;
+	copy->hashed = original->hashed;
+	original->shared--;
+	stringObject->value.svalue = copy;
+}
+
 /**
  * @internal
  * BuildStringFromCString
@@ -1504,6 +1698,10 @@ ctr_object* ctr_string_eq(ctr_object* myself, ctr_argument* argumentList) {
 	if (other->value.svalue->vlen != myself->value.svalue->vlen) {
 		return ctr_build_bool(0);
 	}
+	if (other->value.svalue->hashed && myself->value.svalue->hashed
+		&& other->value.svalue->hash != myself->value.svalue->hash) {
+		return ctr_build_bool(0);
+	}
 	return ctr_build_bool((strncmp(other->value.svalue->value, myself->value.svalue->value, myself->value.svalue->vlen)==0));
 }
 
@@ -1517,6 +1715,10 @@ ctr_object* ctr_string_neq(ctr_object* myself, ctr_argument* argumentList) {
 	if (other->value.svalue->vlen != myself->value.svalue->vlen) {
 		return ctr_build_bool(1);
 	}
+	if (other->value.svalue->hashed && myself->value.svalue->hashed
+		&& other->value.svalue->hash != myself->value.svalue->hash) {
+		return ctr_build_bool(1);
+	}
 	return ctr_build_bool(!(strncmp(other->value.svalue->value, myself->value.svalue->value, myself->value.svalue->vlen)==0));
 }
 
@@ -1585,6 +1787,7 @@ ctr_object* ctr_string_append(ctr_object* myself, ctr_argument* argumentList) {
 		exit(1);
 	}
 	if ( ( n1 + n2 ) == 0 ) return myself;
+	ctr_internal_string_unshare(myself);
 	dest = ctr_heap_allocate( sizeof( char ) * ( n1 + n2 ) );
 	memcpy(dest, myself->value.svalue->value, n1);
 	memcpy(dest+n1, strObject->value.svalue->value, n2);
@@ -1593,6 +1796,7 @@ ctr_object* ctr_string_append(ctr_object* myself, ctr_argument* argumentList) {
 	}
 	myself->value.svalue->value = dest;
 	myself->value.svalue->vlen  = (n1 + n2);
+	myself->value.svalue->hashed = 0;
 	return myself;
 }
 
@@ -2371,6 +2575,7 @@ ctr_object* ctr_string_append_byte( ctr_object* myself, ctr_argument* argumentLi
 	char* dest;
 	char byte;
 	byte = (uint8_t) ctr_internal_cast2number( argumentList->object )->value.nvalue;
+	ctr_internal_string_unshare(myself);
 	dest = ctr_heap_allocate( myself->value.svalue->vlen + 1 );
 	memcpy( dest, myself->value.svalue->value, myself->value.svalue->vlen );
 	*( dest + myself->value.svalue->vlen ) = byte;
@@ -2379,6 +2584,7 @@ ctr_object* ctr_string_append_byte( ctr_object* myself, ctr_argument* argumentLi
 	}
 	myself->value.svalue->value = dest;
 	myself->value.svalue->vlen++;
+	myself->value.svalue->hashed = 0;
 	return myself;
 }
 
@@ -2524,7 +2730,7 @@ ctr_object* ctr_string_eval(ctr_object* myself, ctr_argument* argumentList) {
 	ctr_program_length = code->value.svalue->vlen;
 	parsedCode = ctr_cparse_parse(code->value.svalue->value, pathString);
 	ctr_cwlk_subprogram++;
-	result = ctr_cwlk_run(parsedCode);
+	result = ctr_vm_enabled ? ctr_vm_run(parsedCode) : ctr_cwlk_run(parsedCode);
 	ctr_cwlk_subprogram--;
 	if ( result == NULL ) result = CtrStdNil;
 	ctr_heap_free( newArgumentList );
@@ -2627,54 +2833,258 @@ ctr_object* ctr_build_block(ctr_tnode* node) {
  * refer to the block itself instead of the containing object.
  */
 ctr_object* ctr_block_run(ctr_object* myself, ctr_argument* argList, ctr_object* my) {
+	ctr_argument arguments[CTR_ARGUMENT_VECTOR_SIZE];
+	ctr_argument* tailArguments = NULL;
 	ctr_object* result;
-	ctr_tnode* node = myself->value.block;
-	ctr_tlistitem* codeBlockParts = node->nodes;
-	ctr_tnode* codeBlockPart1 = codeBlockParts->node;
-	ctr_tnode* codeBlockPart2 = codeBlockParts->next->node;
-	ctr_tlistitem* parameterList = codeBlockPart1->nodes;
+	ctr_tnode* node;
+	ctr_tlistitem* codeBlockParts;
+	ctr_tnode* codeBlockPart1;
+	ctr_tnode* codeBlockPart2;
+	ctr_tlistitem* parameterList;
 	ctr_tnode* parameter;
 	ctr_object* a;
-	ctr_open_context();
-	if (parameterList && parameterList->node) {
-		parameter = parameterList->node;
-		while(1) {
-			if (parameter && argList->object) {
-				a = argList->object;
-				ctr_assign_value_to_local(ctr_build_string(parameter->value, parameter->vlen), a);
-			}
-			if (!argList->next) break;
-			argList = argList->next;
-			if (!parameterList->next) break;
-			parameterList = parameterList->next;
+	while(1) {
+		node = myself->value.block;
+		codeBlockParts = node->nodes;
+		codeBlockPart1 = codeBlockParts->node;
+		codeBlockPart2 = codeBlockParts->next->node;
+		parameterList = codeBlockPart1->nodes;
+		ctr_open_context();
+		ctr_context_reserve_slots(node->slot);
+		if (parameterList && parameterList->node) {
 			parameter = parameterList->node;
+			while(1) {
+				if (parameter && argList->object) {
+					a = argList->object;
+					ctr_assign_value_to_slot(parameter->symbol, a, parameter->slot, 1);
+				}
+				if (!argList->next) break;
+				argList = argList->next;
+				if (!parameterList->next) break;
+				parameterList = parameterList->next;
+				parameter = parameterList->node;
+			}
 		}
+		if (my) {
+			ctr_context_receivers[ctr_context_id] = my;
+			ctr_assign_value_to_local_by_ref(ctr_symbol_me, my ); /* me should always point to object, otherwise you have to store me in self and cant use in if */
+			ctr_assign_value_to_local_by_ref(ctr_symbol_me_icon, my );
+		}
+		ctr_assign_value_to_local(ctr_symbol_this_block, myself ); /* otherwise running block may get gc'ed. */
+		result = ctr_vm_enabled ? ctr_vm_run_body(codeBlockPart2, 1) : ctr_cwlk_run_body(codeBlockPart2, 1);
+		if (!ctr_tail_pending) break;
+		/* the block returned a message to a method (tail call) */
+		ctr_tail_pending = 0;
+		if (tailArguments) ctr_argument_vector_free(arguments, tailArguments);
+		tailArguments = ctr_block_tail_arguments(arguments);
+		if (ctr_internal_object_find_property(myself, ctr_symbol_catch, 0)) {
+			/* errors must reach the catch block, so run the method nested */
+			result = ctr_block_run(ctr_tail_block, tailArguments, ctr_tail_receiver);
+			break;
+		}
+		ctr_close_context();
+		myself = ctr_tail_block;
+		my = ctr_tail_receiver;
+		argList = tailArguments;
 	}
-	if (my) {
-		ctr_assign_value_to_local_by_ref(ctr_build_string_from_cstring( ctr_clex_keyword_me ), my ); /* me should always point to object, otherwise you have to store me in self and cant use in if */
-		ctr_assign_value_to_local_by_ref(ctr_build_string_from_cstring( ctr_clex_keyword_me_icon ), my );
-	}
-	ctr_assign_value_to_local(ctr_build_string_from_cstring( "thisBlock" ), myself ); /* otherwise running block may get gc'ed. */
-	result = ctr_cwlk_run(codeBlockPart2);
 	if (result == NULL) {
 		if (my) result = my; else result = myself;
 	}
 	ctr_close_context();
+	if (tailArguments) ctr_argument_vector_free(arguments, tailArguments);
 	if (CtrStdFlow != NULL && CtrStdFlow != CtrStdBreak && CtrStdFlow != CtrStdContinue) {
-		ctr_object* catchBlock = ctr_internal_create_object( CTR_OBJECT_TYPE_OTBLOCK );
-		catchBlock = ctr_internal_object_find_property(myself, ctr_build_string_from_cstring( "catch" ), 0);
+		ctr_object* catchBlock = ctr_internal_object_find_property(myself, ctr_symbol_catch, 0);
 		if (catchBlock != NULL) {
-			ctr_argument* a = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-			a->object = CtrStdFlow;
+			ctr_argument a;
+			a.object = CtrStdFlow;
+			a.next = NULL;
 			CtrStdFlow = NULL;
-			ctr_block_run(catchBlock, a, my);
-			ctr_heap_free( a );
+			ctr_block_run(catchBlock, &a, my);
 			result = myself;
 		}
 	}
 	return result;
 }
 
+/**
+ * @internal
+ *
+ * BlockTailCall
+ *
+ * Records a call to a method (a block) that is the returned
+ * expression of the running block. Instead of running the method
+ * on top of the running block, ctr_block_run leaves the block first
+ * and then runs the method in its place, so tail recursion needs
+ * neither C stack nor contexts.
+ */
+ctr_object* ctr_block_tail_call(ctr_object* block, ctr_argument* argList, ctr_object* my) {
+	int n = 0;
+	ctr_argument* argument;
+	for(argument = argList; argument; argument = argument->next) n++;
+	if (ctr_tail_arguments == NULL) {
+		ctr_tail_arguments_size = CTR_ARGUMENT_VECTOR_SIZE;
+		ctr_tail_arguments = ctr_heap_allocate_tracked( ctr_tail_arguments_size * sizeof( ctr_object* ) );
+		ctr_tail_arguments_tracking_id = ctr_heap_get_latest_tracking_id();
+	}
+	if (n > ctr_tail_arguments_size) {
+		while(ctr_tail_arguments_size < n) ctr_tail_arguments_size *= 2;
+		ctr_tail_arguments = ctr_heap_reallocate_tracked( ctr_tail_arguments_tracking_id, ctr_tail_arguments_size * sizeof( ctr_object* ) );
+	}
+	n = 0;
+	for(argument = argList; argument; argument = argument->next) {
+		ctr_tail_arguments[n++] = argument->object;
+	}
+	ctr_tail_argument_count = n;
+	ctr_tail_block = block;
+	ctr_tail_receiver = my;
+	ctr_tail_pending = 1;
+	return CtrStdNil;
+}
+
+/**
+ * @internal
+ *
+ * BlockTailArguments
+ *
+ * Returns the arguments of the pending tail call as an argument
+ * vector, use ctr_argument_vector_free to release it.
+ */
+ctr_argument* ctr_block_tail_arguments(ctr_argument* buffer) {
+	ctr_argument* argList;
+	int i;
+	argList = ctr_argument_vector(buffer, CTR_ARGUMENT_VECTOR_SIZE, ctr_tail_argument_count);
+	for(i = 0; i < ctr_tail_argument_count; i++) {
+		argList[i].object = ctr_tail_arguments[i];
+	}
+	return argList;
+}
+
+/**
+ * @internal
+ *
+ * BlockLoopStart
+ *
+ * Prepares a block to be run by a native loop. If keep is set and
+ * the parser found the block can run again in the frame of its
+ * previous run, the frame is opened only once and subsequent runs
+ * just rebind the parameter.
+ */
+void ctr_block_loop_start(ctr_block_loop* loop, ctr_object* block, int keep) {
+	loop->block = block;
+	loop->node = block->value.block;
+	loop->index = NULL;
+	loop->keep = keep && (loop->node->flags & CTR_BLOCK_REUSABLE_FRAME);
+	loop->open = 0;
+	loop->blockItem = NULL;
+}
+
+/**
+ * @internal
+ *
+ * BlockLoopIndex
+ *
+ * Returns a number to pass as the loop index. If the block never
+ * changes its parameter, the same number object is reused for every
+ * iteration. This number is flagged as shared so it will be copied
+ * if it gets stored somewhere, just like the small integers.
+ */
+ctr_object* ctr_block_loop_index(ctr_block_loop* loop, ctr_number value) {
+	if (!(loop->node->flags & CTR_BLOCK_SHARED_PARAMETER)) {
+		return ctr_build_number_from_float(value);
+	}
+	if (loop->index == NULL) {
+		loop->index = ctr_build_number_box(value);
+		loop->index->info.shared = 1;
+		loop->index->info.sticky = 1;
+	}
+	loop->index->value.nvalue = value;
+	return loop->index;
+}
+
+/**
+ * @internal
+ *
+ * BlockLoopRun
+ *
+ * Runs the block of a loop with the specified argument (or NULL).
+ * The argument is a fresh or shared object, shared objects are only
+ * bound by reference if the block never changes its parameter.
+ */
+ctr_object* ctr_block_loop_run(ctr_block_loop* loop, ctr_object* argument) {
+	ctr_object* result;
+	ctr_object* catchBlock;
+	ctr_tnode* parameter;
+	ctr_argument a;
+	ctr_size base;
+	int opened = 0;
+	int size;
+	int i;
+	ctr_tlistitem* parameterList = loop->node->nodes->node->nodes;
+	if (!loop->open) {
+		ctr_open_context();
+		ctr_context_reserve_slots(loop->node->slot);
+		loop->open = 1;
+		opened = 1;
+	}
+	if (parameterList && parameterList->node && argument) {
+		parameter = parameterList->node;
+		if (argument->info.shared && !(loop->node->flags & CTR_BLOCK_SHARED_PARAMETER)) {
+			ctr_assign_value_to_slot(parameter->symbol, argument, parameter->slot, 1);
+		} else {
+			ctr_assign_value_to_slot_by_ref(parameter->symbol, argument, parameter->slot);
+		}
+	}
+	if (opened) {
+		ctr_assign_value_to_local(ctr_symbol_this_block, loop->block); /* otherwise running block may get gc'ed. */
+		loop->blockItem = ctr_contexts[ctr_context_id]->properties->head;
+	} else {
+		loop->blockItem->value = loop->block;
+	}
+	result = ctr_vm_enabled ? ctr_vm_run_body(loop->node->nodes->next->node, 0) : ctr_cwlk_run_body(loop->node->nodes->next->node, 0);
+	if (result == NULL) result = loop->block;
+	if (loop->keep && (CtrStdFlow == NULL || CtrStdFlow == CtrStdBreak || CtrStdFlow == CtrStdContinue)) {
+		/* only the slots and thisBlock may live in a frame that is kept */
+		base = ctr_slot_base[ctr_context_id];
+		size = 1;
+		for(i = 0; i < loop->node->slot; i++) {
+			if (ctr_slots[base + i]) size++;
+		}
+		if (ctr_contexts[ctr_context_id]->properties->size == size) return result;
+	}
+	ctr_close_context();
+	loop->open = 0;
+	if (CtrStdFlow != NULL && CtrStdFlow != CtrStdBreak && CtrStdFlow != CtrStdContinue) {
+		catchBlock = ctr_internal_object_find_property(loop->block, ctr_symbol_catch, 0);
+		if (catchBlock != NULL) {
+			a.object = CtrStdFlow;
+			a.next = NULL;
+			CtrStdFlow = NULL;
+			ctr_block_run(catchBlock, &a, NULL);
+			result = loop->block;
+		}
+	}
+	return result;
+}
+
+/**
+ * @internal
+ *
+ * BlockLoopEnd
+ *
+ * Closes the frame of a loop (if still open) and releases the
+ * loop index.
+ */
+void ctr_block_loop_end(ctr_block_loop* loop) {
+	if (loop->open) {
+		ctr_close_context();
+		loop->open = 0;
+	}
+	if (loop->index) {
+		loop->index->info.sticky = 0;
+		loop->index = NULL;
+	}
+}
+
 /**
  * [Block] whileTrue: [block]
  *
@@ -2692,17 +3102,28 @@ ctr_object* ctr_block_run(ctr_object* myself, ctr_argument* argList, ctr_object*
  * Don't forget to use the return ^ symbol in the first block.
  */
 ctr_object* ctr_block_while_true(ctr_object* myself, ctr_argument* argumentList) {
+	ctr_block_loop condition;
+	ctr_block_loop body;
 	int sticky1, sticky2;
+	if (argumentList->object->info.type != CTR_OBJECT_TYPE_OTBLOCK) {
+		CtrStdFlow = ctr_build_string_from_cstring("Expected block.");
+		return myself;
+	}
 	sticky1 = myself->info.sticky;
 	sticky2 = argumentList->object->info.sticky;
 	myself->info.sticky = 1;
 	argumentList->object->info.sticky = 1;
+	/* the frame of the condition is kept below the one of the body */
+	ctr_block_loop_start(&condition, myself, myself->value.block->slot == 0);
+	ctr_block_loop_start(&body, argumentList->object, 0);
 	while (1 && !CtrStdFlow) {
-		ctr_object* result = ctr_internal_cast2bool(ctr_block_run(myself, argumentList, NULL));
+		ctr_object* result = ctr_internal_cast2bool(ctr_block_loop_run(&condition, argumentList->object));
 		if (result->value.bvalue == 0 || CtrStdFlow) break;
-		ctr_block_run(argumentList->object, argumentList, NULL);
+		ctr_block_loop_run(&body, argumentList->object);
 		if (CtrStdFlow == CtrStdContinue) CtrStdFlow = NULL; /* consume continue */
 	}
+	ctr_block_loop_end(&body);
+	ctr_block_loop_end(&condition);
 	if (CtrStdFlow == CtrStdBreak) CtrStdFlow = NULL; /* consume break */
 	myself->info.sticky = sticky1;
 	argumentList->object->info.sticky = sticky2;
@@ -2726,12 +3147,22 @@ ctr_object* ctr_block_while_true(ctr_object* myself, ctr_argument* argumentList)
  * Don't forget to use the return ^ symbol in the first block.
  */
 ctr_object* ctr_block_while_false(ctr_object* myself, ctr_argument* argumentList) {
+	ctr_block_loop condition;
+	ctr_block_loop body;
+	if (argumentList->object->info.type != CTR_OBJECT_TYPE_OTBLOCK) {
+		CtrStdFlow = ctr_build_string_from_cstring("Expected block.");
+		return myself;
+	}
+	ctr_block_loop_start(&condition, myself, myself->value.block->slot == 0);
+	ctr_block_loop_start(&body, argumentList->object, 0);
 	while (1 && !CtrStdFlow) {
-		ctr_object* result = ctr_internal_cast2bool(ctr_block_run(myself, argumentList, NULL));
+		ctr_object* result = ctr_internal_cast2bool(ctr_block_loop_run(&condition, argumentList->object));
 		if (result->value.bvalue == 1 || CtrStdFlow) break;
-		ctr_block_run(argumentList->object, argumentList, NULL);
+		ctr_block_loop_run(&body, argumentList->object);
 		if (CtrStdFlow == CtrStdContinue) CtrStdFlow = NULL; /* consume continue */
 	}
+	ctr_block_loop_end(&body);
+	ctr_block_loop_end(&condition);
 	if (CtrStdFlow == CtrStdBreak) CtrStdFlow = NULL; /* consume break */
 	return myself;
 }
@@ -2828,8 +3259,8 @@ ctr_object* ctr_block_error(ctr_object* myself, ctr_argument* argumentList) {
  */
 ctr_object* ctr_block_catch(ctr_object* myself, ctr_argument* argumentList) {
 	ctr_object* catchBlock = argumentList->object;
-	ctr_internal_object_delete_property(myself, ctr_build_string_from_cstring( "catch" ), 0 );
-	ctr_internal_object_add_property(myself, ctr_build_string_from_cstring( "catch" ), catchBlock, 0 );
+	ctr_internal_object_delete_property(myself, ctr_symbol_catch, 0 );
+	ctr_internal_object_add_property(myself, ctr_symbol_catch, catchBlock, 0 );
 	return myself;
 }
 
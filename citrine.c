@@ -33,6 +33,14 @@ void ctr_cli_read_args(int argc, char* argv[]) {
 		ctr_cli_welcome();
 		exit(0);
 	}
+	if (argc > 2 && strcmp(argv[1], "-b") == 0) {
+		/* -b: run on the bytecode VM, hide the switch from the program */
+		ctr_vm_enabled = 1;
+		argc--;
+		argv++;
+		ctr_argc = argc;
+		ctr_argv = argv;
+	}
 	ctr_mode_input_file = (char*) ctr_heap_allocate_tracked( sizeof( char ) * 255 );
 	strncpy(ctr_mode_input_file, argv[1], 254);
 }
@@ -51,11 +59,17 @@ int main(int argc, char* argv[]) {
 	ctr_argv = argv;
 	ctr_gc_memlimit = 8388608;
 	ctr_callstack_index = 0;
+	ctr_stack_base = (char*) &prg;
+	ctr_stack_size = ctr_internal_stack_size();
+	ctr_context_max_depth = 0;
 	ctr_source_map_head = NULL;
 	ctr_source_mapping = 0;
 	CtrStdFlow = NULL;
 	ctr_command_security_profile = 0;
 	ctr_command_tick = 0;
+	ctr_vm_enabled = 0;
+	ctr_vm_stack = NULL;
+	ctr_vm_top = 0;
 	ctr_cli_read_args(argc, argv);
 	ctr_source_mapping = 1;
 	ctr_clex_keyword_me = CTR_DICT_ME;
@@ -71,11 +85,12 @@ int main(int argc, char* argv[]) {
 	ctr_clex_string_interpolation_start_len = strlen( CTR_DICT_STR_IPOL_START );
 	ctr_clex_string_interpolation_stop_len = strlen( CTR_DICT_STR_IPOL_STOP );
 	prg = ctr_internal_readf(ctr_mode_input_file, &program_text_size);
+	ctr_initialize_world(); /* before parsing, the parser interns symbols */
 	program = ctr_cparse_parse(prg, ctr_mode_input_file);
 	/*ctr_internal_debug_tree(program,1); -- for debugging */
-	ctr_initialize_world();
-	ctr_cwlk_run(program);
-	ctr_gc_sweep(1);
+	if (ctr_vm_enabled) ctr_vm_run(program); else ctr_cwlk_run(program);
+	ctr_gc_sweep(1, NULL);
+	ctr_heap_free( ctr_symbols );
 	ctr_heap_free( prg );
 	ctr_heap_free_rest();
 	//For memory profiling
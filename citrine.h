@@ -58,6 +58,9 @@
 #define CTR_AST_NODE_LTRBOOLFALSE 82
 #define CTR_AST_NODE_LTRNIL 83
 #define CTR_AST_NODE_PROGRAM 84
+#define CTR_AST_NODE_LTRCONST 85
+#define CTR_AST_NODE_REFSLOT 86
+#define CTR_AST_NODE_NATIVEMESSAGE 87
 
 /**
  * Define the basic object types.
@@ -118,19 +121,55 @@ typedef  size_t ctr_size;
 struct ctr_string {
 	char* value;
 	ctr_size vlen;
+	uint64_t hash; /* cached hash, only valid if hashed is set */
+	char hashed;   /* cleared by messages that modify the string */
+	int shared;    /* number of other string objects sharing this value (copy-on-write) */
 };
 typedef struct ctr_string ctr_string;
 
 
 /**
- * Map 
+ * Map
+ *
+ * Items are kept in a linked list (newest first), maps having
+ * more than CTR_MAP_INDEX_THRESHOLD items also get an open
+ * addressing index (capacity is a power of 2). In shape mode
+ * the items live in a single array in shape order and the list
+ * links them from the last one to the first one.
  */
+#define CTR_MAP_INDEX_THRESHOLD 8
 struct ctr_map {
 	struct ctr_mapitem* head;
 	int size;
+	struct ctr_mapitem** index;
+	int capacity;
+	struct ctr_shape* shape; /* property maps only, NULL in dictionary mode */
+	struct ctr_mapitem* items; /* shape mode: the items, in shape order */
+	int itemsCapacity;
 };
 typedef struct ctr_map ctr_map;
 
+/**
+ * Shape (hidden class)
+ *
+ * Describes the property names of an object in the order they
+ * were added. Objects that gain the same properties in the same
+ * order share a shape, a property occupies the same position
+ * in the item array of all of them. Shapes form a tree of
+ * transitions starting at ctr_shape_root and are never freed.
+ * Maps with deleted properties, non-symbol keys or more than
+ * CTR_SHAPE_MAX_SIZE properties switch to dictionary mode.
+ */
+#define CTR_SHAPE_MAX_SIZE 64
+struct ctr_shape {
+	struct ctr_object* key; /* property added by this transition */
+	int size;
+	struct ctr_shape* parent;
+	struct ctr_shape* child;
+	struct ctr_shape* sibling;
+};
+typedef struct ctr_shape ctr_shape;
+
 /**
  * Map item
  */
@@ -152,6 +191,13 @@ struct ctr_argument {
 };
 typedef struct ctr_argument ctr_argument;
 
+/**
+ * Arguments are passed as a vector of ctr_argument items, each item
+ * also links to the next one so natives can walk them as a list.
+ * Vectors up to CTR_ARGUMENT_VECTOR_SIZE items live on the C stack.
+ */
+#define CTR_ARGUMENT_VECTOR_SIZE 8
+
 /**
  * Root Object
  */
@@ -164,6 +210,10 @@ struct ctr_object {
 		unsigned int sticky: 1;
 		unsigned int chainMode: 1;
 		unsigned int remote: 1;
+		unsigned int interned: 1;
+		unsigned int shared: 1;
+		unsigned int old: 1;
+		unsigned int remembered: 1;
 	} info;
 	struct ctr_object* link;
 	union uvalue {
@@ -179,6 +229,30 @@ struct ctr_object {
 };
 typedef struct ctr_object ctr_object;
 
+/**
+ * Integral numbers within this range are represented by shared,
+ * immutable number objects (see ctr_build_number_from_float).
+ */
+#define CTR_NUMBER_IMMEDIATE_MIN -128
+#define CTR_NUMBER_IMMEDIATE_MAX 1023
+
+/**
+ * Binary number operations computed inline by the walker and the
+ * VM (see ctr_number_op_apply), 0 means no fast path.
+ */
+#define CTR_NUMBER_OP_PLUS 1
+#define CTR_NUMBER_OP_MINUS 2
+#define CTR_NUMBER_OP_MULTIPLY 3
+#define CTR_NUMBER_OP_DIVIDE 4
+#define CTR_NUMBER_OP_MODULO 5
+#define CTR_NUMBER_OP_GREATER 6
+#define CTR_NUMBER_OP_GREATER_OR_EQUAL 7
+#define CTR_NUMBER_OP_LESS 8
+#define CTR_NUMBER_OP_LESS_OR_EQUAL 9
+#define CTR_NUMBER_OP_EQUALS 10
+#define CTR_NUMBER_OP_UNEQUALS 11
+#define CTR_NUMBER_OP_COUNT 12
+
 /**
  * Citrine Resource
  */
@@ -200,6 +274,73 @@ struct ctr_collection {
 typedef struct ctr_collection ctr_collection;
 
 
+/**
+ * Inline Cache
+ *
+ * Remembers the methods found by a message node for the
+ * last few receivers (keyed by method table owner).
+ */
+#define CTR_INLINE_CACHE_SIZE 4
+struct ctr_inline_cache {
+	uint64_t epoch;
+	int next;
+	struct ctr_object* keys[CTR_INLINE_CACHE_SIZE];
+	struct ctr_object* methods[CTR_INLINE_CACHE_SIZE];
+};
+typedef struct ctr_inline_cache ctr_inline_cache;
+
+/**
+ * Method Cache
+ *
+ * Global, direct-mapped cache of method lookups keyed by
+ * method table owner and selector. Entries with a NULL method
+ * record that the lookup failed (respondTo: will be used).
+ */
+#define CTR_METHOD_CACHE_SIZE 4096
+struct ctr_method_cache_entry {
+	uint64_t epoch;
+	struct ctr_object* key;
+	struct ctr_object* selector;
+	struct ctr_object* method;
+};
+typedef struct ctr_method_cache_entry ctr_method_cache_entry;
+
+/**
+ * Bytecode
+ *
+ * Programs and code blocks can be compiled to a flat list of
+ * instructions (see vm.c). Operands refer to the AST node the
+ * instruction has been compiled from.
+ */
+#define CTR_OP_PUSH_NIL    1
+#define CTR_OP_PUSH_TRUE   2
+#define CTR_OP_PUSH_FALSE  3
+#define CTR_OP_PUSH_NUMBER 4
+#define CTR_OP_PUSH_STRING 5
+#define CTR_OP_PUSH_BLOCK  6
+#define CTR_OP_LOAD        7
+#define CTR_OP_MARK        8
+#define CTR_OP_STORE       9
+#define CTR_OP_SEND        10
+#define CTR_OP_POP         11
+#define CTR_OP_RETURN      12
+#define CTR_OP_END         13
+#define CTR_OP_HALT        14
+#define CTR_OP_TAILSEND    15
+struct ctr_instruction {
+	uint8_t op;
+	uint8_t argc;
+	struct ctr_tnode* node;
+};
+typedef struct ctr_instruction ctr_instruction;
+
+struct ctr_bytecode {
+	ctr_instruction* instructions;
+	int length;
+	int depth; /* maximum number of values on the stack */
+};
+typedef struct ctr_bytecode ctr_bytecode;
+
 /**
  * AST Node
  */
@@ -209,6 +350,18 @@ struct ctr_tnode {
 	char* value;
 	ctr_size vlen;
 	struct ctr_tlistitem* nodes;
+	ctr_inline_cache* cache;
+	ctr_object* symbol;
+	uint8_t op; /* binary message: number fast path (CTR_NUMBER_OP_*) */
+	int slot; /* reference: local slot (1 = first, 0 = none), block: number of slots */
+	ctr_shape* shape; /* property reference: shape seen last time */
+	int shapeSlot; /* property reference: position of the property in that shape */
+	ctr_number nvalue; /* number literal: value decoded by the parser */
+	ctr_bytecode* code; /* program or instruction list: compiled bytecode */
+	ctr_object* constant; /* quickened literal: its value, quickened message: the native method */
+	ctr_object* quickKey; /* quickened message: method table owner of the receiver */
+	uint64_t quickEpoch; /* quickened message: method epoch */
+	uint8_t flags; /* block: CTR_BLOCK_* properties found by the parser */
 };
 typedef struct ctr_tnode ctr_tnode;
 
@@ -240,6 +393,8 @@ ctr_object* CtrStdBlock;
 ctr_object* CtrStdString;
 ctr_object* CtrStdNumber;
 ctr_object* CtrStdBool;
+ctr_object* CtrStdTrue;
+ctr_object* CtrStdFalse;
 ctr_object* CtrStdConsole;
 ctr_object* CtrStdNil;
 ctr_object* CtrStdGC;
@@ -257,6 +412,14 @@ ctr_object* CtrStdBreak;
 ctr_object* CtrStdContinue;
 ctr_object* CtrStdExit;
 ctr_object* ctr_first_object;
+ctr_object* ctr_number_immediates[CTR_NUMBER_IMMEDIATE_MAX - CTR_NUMBER_IMMEDIATE_MIN + 1];
+
+/**
+ * Selectors of the number fast paths and whether the Number
+ * method for each of them is still the built-in one.
+ */
+ctr_object* ctr_number_op_selectors[CTR_NUMBER_OP_COUNT];
+char ctr_number_op_enabled[CTR_NUMBER_OP_COUNT];
 
 /**
  * Hashkey
@@ -319,13 +482,47 @@ int ctr_utf8size(char c);
 ctr_tnode* ctr_cparse_parse(char* prg, char* pathString);
 ctr_tnode* ctr_cparse_expr(int mode);
 ctr_tnode* ctr_cparse_ret();
+void       ctr_cparse_resolve(ctr_tnode* node);
+
+/**
+ * Maximum number of local slots of a block, other locals
+ * are looked up by name.
+ */
+#define CTR_MAX_SLOTS 64
+
+/**
+ * Block properties found by the parser.
+ * REUSABLE_FRAME: no local is referenced before it has been
+ * declared, so the block can run again in the frame of its
+ * previous run.
+ * SHARED_PARAMETER: the first parameter only receives binary
+ * arithmetic and comparison messages, so it can be bound to a
+ * shared number.
+ */
+#define CTR_BLOCK_REUSABLE_FRAME 1
+#define CTR_BLOCK_SHARED_PARAMETER 2
 
 /**
  * Abstract Tree Walker functions
  */
 uint64_t    ctr_cwlk_subprogram;
 ctr_object* ctr_cwlk_run(ctr_tnode* program);
+ctr_object* ctr_cwlk_run_body(ctr_tnode* program, int tail);
 ctr_object* ctr_cwlk_expr(ctr_tnode* node, char* wasReturn);
+ctr_object* ctr_cwlk_message(ctr_tnode* paramNode, int tail);
+void        ctr_cwlk_uncaught_error();
+
+/**
+ * Bytecode compiler and virtual machine
+ */
+int         ctr_vm_enabled;
+ctr_object** ctr_vm_stack;
+int         ctr_vm_stack_size;
+int         ctr_vm_top;
+size_t      ctr_vm_stack_tracking_id;
+void        ctr_vm_compile(ctr_tnode* program);
+ctr_object* ctr_vm_run(ctr_tnode* program);
+ctr_object* ctr_vm_run_body(ctr_tnode* program, int tail);
 
 /**
  * Internal World functions
@@ -335,38 +532,152 @@ char*       ctr_internal_memmem(char* haystack, long hlen, char* needle, long nl
 void        ctr_internal_object_add_property(ctr_object* owner, ctr_object* key, ctr_object* value, int m);
 void        ctr_internal_object_set_property(ctr_object* owner, ctr_object* key, ctr_object* value, int is_method);
 void        ctr_internal_object_delete_property(ctr_object* owner, ctr_object* key, int is_method);
+ctr_mapitem* ctr_internal_map_find(ctr_map* map, ctr_object* key);
+void ctr_internal_map_move_to_front(ctr_map* map, ctr_mapitem* item);
+void ctr_internal_map_dictionary(ctr_map* map);
+ctr_mapitem* ctr_internal_shape_lookup(ctr_map* map, ctr_object* key, ctr_tnode* site);
 ctr_object* ctr_internal_object_find_property(ctr_object* owner, ctr_object* key, int is_method);
 uint64_t    ctr_internal_index_hash(ctr_object* key);
 void        ctr_internal_object_add_property(ctr_object* owner, ctr_object* key, ctr_object* value, int m);
+ctr_map*    ctr_internal_object_map(ctr_object* owner, int is_method);
 ctr_object* ctr_internal_cast2bool( ctr_object* o );
 ctr_object* ctr_internal_cast2number(ctr_object* o);
 ctr_object* ctr_internal_create_object(int type);
+ctr_object* ctr_internal_create_context();
+size_t      ctr_internal_stack_size();
 ctr_object* ctr_internal_cast2string( ctr_object* o );
 void*       ctr_internal_plugin_find( ctr_object* key );
 ctr_object* ctr_find(ctr_object* key);
-ctr_object* ctr_find_in_my(ctr_object* key);
+ctr_object* ctr_find_me();
+ctr_object* ctr_unshare_me();
+ctr_object* ctr_find_in_my(ctr_object* key, ctr_tnode* site);
 ctr_object* ctr_assign_value(ctr_object* key, ctr_object* val);
-ctr_object* ctr_assign_value_to_my(ctr_object* key, ctr_object* val);
+ctr_object* ctr_assign_value_to_my(ctr_object* key, ctr_object* val, ctr_tnode* site);
 ctr_object* ctr_assign_value_to_local(ctr_object* key, ctr_object* val);
 ctr_object* ctr_assign_value_to_local_by_ref(ctr_object* key, ctr_object* val);
+ctr_object* ctr_assign_value_to_slot(ctr_object* key, ctr_object* val, int slot, int declare);
+ctr_object* ctr_assign_value_to_slot_by_ref(ctr_object* key, ctr_object* val, int slot);
+ctr_object* ctr_find_slot(ctr_object* key, int slot);
+ctr_object* ctr_internal_copy_on_assign(ctr_object* o);
+ctr_object* ctr_internal_unshare(ctr_object* o);
+ctr_argument* ctr_argument_vector(ctr_argument* buffer, int size, int count);
+void ctr_argument_vector_free(ctr_argument* buffer, ctr_argument* vector);
 char*       ctr_internal_readf(char* file_name, uint64_t* size_allocated);
 void        ctr_internal_debug_tree(ctr_tnode* ti, int indent);
 ctr_object* ctr_send_message(ctr_object* receiver, char* message, long len, ctr_argument* argumentList);
+ctr_object* ctr_send_message_cached(ctr_object* receiver, ctr_object* selector, ctr_argument* argumentList, ctr_inline_cache* cache);
+ctr_object* ctr_send_message_dispatch(ctr_object* receiver, ctr_object* selector, ctr_argument* argumentList, ctr_inline_cache* cache, int tail);
+ctr_object* ctr_inline_cache_key(ctr_object* receiverObject);
+ctr_object* ctr_inline_cache_lookup(ctr_inline_cache* cache, ctr_object* key);
+ctr_object* ctr_internal_symbol(char* name, ctr_size vlen, int create);
 void ctr_internal_create_func(ctr_object* o, ctr_object* key, ctr_object* (*func)( ctr_object*, ctr_argument* ) );
 
+/**
+ * Symbol table, interned selectors and identifiers.
+ */
+ctr_object** ctr_symbols;
+ctr_size ctr_symbols_size;
+ctr_size ctr_symbols_count;
+
+/**
+ * Method epoch, changes whenever a method table changes
+ * (invalidates inline caches and the method cache).
+ */
+uint64_t ctr_method_epoch;
+
+/**
+ * Shape of objects without properties.
+ */
+ctr_shape ctr_shape_root;
+
+/**
+ * Maps of objects without properties or methods, shared until the
+ * first item gets added (see ctr_internal_object_map).
+ */
+ctr_map ctr_map_no_properties;
+ctr_map ctr_map_no_methods;
+
+ctr_method_cache_entry ctr_method_cache[CTR_METHOD_CACHE_SIZE];
+
 /**
  * Scoping functions
  */
 void ctr_open_context();
 void ctr_close_context();
+void ctr_context_reserve_slots(int n);
 
 /**
  * Global Scoping variables
  */
-ctr_object* ctr_contexts[300];
+/**
+ * Contexts (frames) are kept on a stack that grows as needed, the
+ * context objects above ctr_context_id are kept (empty) for reuse.
+ * Nesting is limited by the C stack: a context cannot be opened if
+ * less than CTR_STACK_RESERVE bytes of the stack (ctr_stack_size bytes
+ * from ctr_stack_base) are left, or if less than 5% of the memory
+ * limit is left. Program maxNestedCalls: also sets a
+ * fixed limit (ctr_context_max_depth, 0 means no fixed limit).
+ */
+#define CTR_STACK_RESERVE 262144
+#define CTR_STACK_DEFAULT_SIZE 8388608
+char* ctr_stack_base;
+size_t ctr_stack_size;
+int ctr_context_max_depth;
+ctr_object** ctr_contexts;
+int ctr_contexts_size;
+size_t ctr_contexts_tracking_id;
+
+/**
+ * Receiver (me) of every context, NULL if the context belongs
+ * to a block that runs without one (see ctr_find_me).
+ */
+ctr_object** ctr_context_receivers;
+size_t ctr_context_receivers_tracking_id;
+
+/**
+ * Interned keys assigned or looked up by every block run.
+ */
+ctr_object* ctr_symbol_me;
+ctr_object* ctr_symbol_me_icon;
+ctr_object* ctr_symbol_this_block;
+ctr_object* ctr_symbol_catch;
 int ctr_context_id;
-ctr_tnode* ctr_callstack[300];
-uint8_t ctr_callstack_index;
+#define CTR_CALLSTACK_SIZE 1024
+ctr_tnode* ctr_callstack[CTR_CALLSTACK_SIZE];
+int ctr_callstack_index;
+
+/**
+ * Pushes a node on the call stack (used for error traces), nodes
+ * beyond the size of the stack are counted but not recorded.
+ */
+#define ctr_callstack_push(node) do { \
+	if (ctr_callstack_index < CTR_CALLSTACK_SIZE) ctr_callstack[ctr_callstack_index] = (node); \
+	ctr_callstack_index++; \
+} while(0)
+
+/**
+ * Pending tail call, set by ctr_block_tail_call and performed by
+ * ctr_block_run after the running block has been left.
+ */
+int ctr_tail_pending;
+ctr_object* ctr_tail_block;
+ctr_object* ctr_tail_receiver;
+ctr_object** ctr_tail_arguments;
+int ctr_tail_argument_count;
+int ctr_tail_arguments_size;
+size_t ctr_tail_arguments_tracking_id;
+
+/**
+ * Local variable slots, every context owns the slots from
+ * ctr_slot_base[context id] up to the next context. A slot points
+ * to the map item holding the variable in the context.
+ */
+ctr_mapitem** ctr_slots;
+ctr_size ctr_slots_size;
+ctr_size ctr_slots_top;
+size_t ctr_slots_tracking_id;
+ctr_size* ctr_slot_base;
+size_t ctr_slot_base_tracking_id;
 
 /**
  * Nil Interface
@@ -508,6 +819,21 @@ ctr_object* ctr_string_to_byte_array( ctr_object* myself, ctr_argument* argument
 ctr_object* ctr_string_append_byte(ctr_object* myself, ctr_argument* argumentList );
 ctr_object* ctr_string_randomize_bytes(ctr_object* myself, ctr_argument* argumentList );
 
+/**
+ * Block loop, runs a block for each iteration of a native loop
+ * (times:, to:step:do:, whileTrue:) keeping its frame between
+ * iterations if possible.
+ */
+struct ctr_block_loop {
+	ctr_object* block;
+	ctr_tnode* node;
+	ctr_object* index; /* mutable (shared) number for the loop index */
+	ctr_mapitem* blockItem; /* thisBlock in the frame */
+	int keep; /* keep the frame open between iterations */
+	int open; /* the frame is open */
+};
+typedef struct ctr_block_loop ctr_block_loop;
+
 /**
  * Block Interface
  */
@@ -518,6 +844,12 @@ ctr_object* ctr_block_catch(ctr_object* myself, ctr_argument* argumentList);
 ctr_object* ctr_block_while_true(ctr_object* myself, ctr_argument* argumentList);
 ctr_object* ctr_block_while_false(ctr_object* myself, ctr_argument* argumentList);
 ctr_object* ctr_block_run(ctr_object* myself, ctr_argument* argList, ctr_object* my);
+ctr_object* ctr_block_tail_call(ctr_object* block, ctr_argument* argList, ctr_object* my);
+ctr_argument* ctr_block_tail_arguments(ctr_argument* buffer);
+void ctr_block_loop_start(ctr_block_loop* loop, ctr_object* block, int keep);
+ctr_object* ctr_block_loop_index(ctr_block_loop* loop, ctr_number value);
+ctr_object* ctr_block_loop_run(ctr_block_loop* loop, ctr_object* argument);
+void ctr_block_loop_end(ctr_block_loop* loop);
 ctr_object* ctr_block_times(ctr_object* myself, ctr_argument* argumentList);
 ctr_object* ctr_block_to_string(ctr_object* myself, ctr_argument* argumentList);
 
@@ -620,6 +952,7 @@ ctr_object* ctr_command_forbid_file_read(ctr_object* myself, ctr_argument* ctr_a
 ctr_object* ctr_command_forbid_include(ctr_object* myself, ctr_argument* ctr_argumentList);
 ctr_object* ctr_command_forbid_fork(ctr_object* myself, ctr_argument* ctr_argumentList);
 ctr_object* ctr_command_countdown(ctr_object* myself, ctr_argument* ctr_argumentList);
+ctr_object* ctr_command_max_nested_calls(ctr_object* myself, ctr_argument* argumentList);
 ctr_object* ctr_command_fork(ctr_object* myself, ctr_argument* ctr_argumentList);
 ctr_object* ctr_command_message(ctr_object* myself, ctr_argument* argumentList);
 ctr_object* ctr_command_listen(ctr_object* myself, ctr_argument* argumentList);
@@ -701,7 +1034,9 @@ ctr_object* ctr_gc_kept_alloc(ctr_object* myself, ctr_argument* argumentList);
 ctr_object* ctr_gc_sticky_count(ctr_object* myself, ctr_argument* argumentList);
 ctr_object* ctr_gc_setmode(ctr_object* myself, ctr_argument* argumentList);
 ctr_object* ctr_gc_setmemlimit(ctr_object* myself, ctr_argument* argumentList);
-void ctr_gc_sweep( int all );
+ctr_object* ctr_gc_setmaxpause(ctr_object* myself, ctr_argument* argumentList);
+void ctr_gc_sweep( int all, ctr_object* end );
+void ctr_gc_write_barrier( ctr_object* owner, ctr_object* value );
 
 /**
  * Global Garbage Collector variables
@@ -712,6 +1047,56 @@ int ctr_gc_kept_counter;
 int ctr_gc_sticky_counter;
 int ctr_gc_mode;
 
+/**
+ * Generations: objects are added to the front of the object list,
+ * the objects in front of ctr_gc_old_objects have been created after
+ * the latest collection (young), the others have survived one
+ * (old). Old objects that may refer to young ones are remembered.
+ */
+ctr_object* ctr_gc_old_objects;
+ctr_object** ctr_gc_remembered;
+int ctr_gc_remembered_count;
+int ctr_gc_remembered_size;
+size_t ctr_gc_remembered_tracking_id;
+
+/**
+ * Incremental marking: marked objects on the gray stack still have to
+ * be scanned, other marked objects are black, unmarked ones white.
+ */
+int ctr_gc_marking;
+int ctr_gc_young;
+int ctr_gc_max_pause;
+
+/**
+ * A frame on the gray stack, holds the object being scanned and how far
+ * the scan got (phase 0: elements, 1: properties, 2: methods). The step
+ * tells whether the program ran since, map items might have been removed.
+ */
+struct ctr_gc_frame {
+	ctr_object* object;
+	ctr_mapitem* item;
+	long index;
+	int phase;
+	int step;
+};
+typedef struct ctr_gc_frame ctr_gc_frame;
+ctr_gc_frame* ctr_gc_gray;
+int ctr_gc_gray_count;
+int ctr_gc_gray_size;
+size_t ctr_gc_gray_tracking_id;
+int ctr_gc_step;
+
+/**
+ * While scanning, the collector prefetches the objects it will visit a
+ * few steps ahead.
+ */
+#define CTR_GC_PREFETCH_DISTANCE 8
+#ifdef __GNUC__
+#define ctr_gc_prefetch(address) __builtin_prefetch(address)
+#else
+#define ctr_gc_prefetch(address)
+#endif
+
 uint64_t ctr_gc_alloc;
 uint64_t ctr_gc_memlimit;
 
@@ -727,20 +1112,34 @@ ctr_object* ctr_dice_rand(ctr_object* myself, ctr_argument* argumentList);
  */
 ctr_object* ctr_build_empty_string();
 ctr_object* ctr_build_string(char* object, long vlen);
+ctr_object* ctr_build_string_shared(ctr_object* original);
+void ctr_internal_string_unshare(ctr_object* stringObject);
 ctr_object* ctr_build_block(ctr_tnode* node);
 ctr_object* ctr_build_number(char* object);
 ctr_object* ctr_build_number_from_string(char* fixedStr, ctr_size strLength);
 ctr_object* ctr_build_number_from_float(ctr_number floatNumber);
+ctr_object* ctr_build_number_box(ctr_number floatNumber);
+void ctr_number_initialize_immediates();
+void ctr_number_initialize_ops();
+uint8_t ctr_number_op(ctr_object* selector);
+void ctr_number_op_invalidate(ctr_object* selector);
+ctr_object* ctr_number_op_apply(uint8_t op, ctr_object* myself, ctr_object* other);
 ctr_object* ctr_build_bool(int truth);
+ctr_object* ctr_build_bool_box(int truth);
 ctr_object* ctr_build_nil();
 ctr_object* ctr_build_string_from_cstring( char* str );
 void ctr_gc_internal_collect();
+void ctr_gc_internal_collect_young();
+void ctr_gc_internal_collect_auto();
+void ctr_gc_internal_collect_start();
+void ctr_gc_internal_collect_step();
 
 
 void* ctr_heap_allocate( size_t size );
 void* ctr_heap_allocate_tracked( size_t size );
 void  ctr_heap_free( void* ptr );
 void  ctr_heap_free_rest();
+void  ctr_heap_trim( int all );
 void* ctr_heap_reallocate(void* oldptr, size_t size );
 size_t ctr_heap_get_latest_tracking_id();
 void* ctr_heap_reallocate_tracked(size_t tracking_id, size_t size );
@@ -75,8 +75,9 @@ ctr_object* ctr_array_push(ctr_object* myself, ctr_argument* argumentList) {
 			(sizeof(ctr_object*) * (myself->value.avalue->length))
 		);
 	}
-	pushValue = argumentList->object;
+	pushValue = ctr_internal_unshare(argumentList->object);
 	*(myself->value.avalue->elements + myself->value.avalue->head) = pushValue;
+	ctr_gc_write_barrier(myself, pushValue);
 	myself->value.avalue->head++;
 	return myself;
 }
@@ -203,6 +204,7 @@ ctr_object* ctr_array_product(ctr_object* myself, ctr_argument* argumentList) {
  * }.
  */
 ctr_object* ctr_array_map(ctr_object* myself, ctr_argument* argumentList) {
+	ctr_argument arguments[3];
 	ctr_object* block = argumentList->object;
 	int i = 0;
 	if (block->info.type != CTR_OBJECT_TYPE_OTBLOCK) {
@@ -211,23 +213,15 @@ ctr_object* ctr_array_map(ctr_object* myself, ctr_argument* argumentList) {
 	}
 	block->info.sticky = 1;
 	for(i = myself->value.avalue->tail; i < myself->value.avalue->head; i++) {
-		ctr_argument* arguments = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		ctr_argument* argument2 = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		ctr_argument* argument3 = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		arguments->object = ctr_build_number_from_float((double) i);
-		argument2->object = *(myself->value.avalue->elements + i);
-		argument3->object = myself;
-		arguments->next = argument2;
-		argument2->next = argument3;
-		ctr_block_run(block, arguments, NULL);
-		ctr_heap_free( arguments );
-		ctr_heap_free( argument2 );
-		ctr_heap_free( argument3 );
+		ctr_argument* a = ctr_argument_vector(arguments, 3, 3);
+		a[0].object = ctr_build_number_from_float((double) i);
+		a[1].object = *(myself->value.avalue->elements + i);
+		a[2].object = myself;
+		ctr_block_run(block, a, NULL);
 		if (CtrStdFlow == CtrStdContinue) CtrStdFlow = NULL;
 		if (CtrStdFlow) break;
 	}
 	if (CtrStdFlow == CtrStdBreak) CtrStdFlow = NULL; /* consume break */
-	block->info.mark = 0;
 	block->info.sticky = 0;
 	return myself;
 }
@@ -284,7 +278,8 @@ ctr_object* ctr_array_unshift(ctr_object* myself, ctr_argument* argumentList) {
 		myself->value.avalue->head++;
 		memmove(myself->value.avalue->elements+1, myself->value.avalue->elements,myself->value.avalue->head*sizeof(ctr_object*));
 	}
-	*(myself->value.avalue->elements + myself->value.avalue->tail) = pushValue;
+	*(myself->value.avalue->elements + myself->value.avalue->tail) = ctr_internal_unshare(pushValue);
+	ctr_gc_write_barrier(myself, *(myself->value.avalue->elements + myself->value.avalue->tail));
 	return myself;
 }
 
@@ -460,7 +455,8 @@ ctr_object* ctr_array_put(ctr_object* myself, ctr_argument* argumentList) {
 		}
 		myself->value.avalue->tail = putIndexNumber;
 	}
-	*(myself->value.avalue->elements + putIndexNumber) = putValue;
+	*(myself->value.avalue->elements + putIndexNumber) = ctr_internal_unshare(putValue);
+	ctr_gc_write_barrier(myself, *(myself->value.avalue->elements + putIndexNumber));
 	return myself;
 }
 
@@ -575,17 +571,14 @@ ctr_object* ctr_array_add(ctr_object* myself, ctr_argument* argumentList) {
  */
 ctr_object* temp_sorter;
 int ctr_sort_cmp(const void * a, const void * b) {
-	ctr_argument* arg1 = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-	ctr_argument* arg2 = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
+	ctr_argument arguments[2];
+	ctr_argument* args = ctr_argument_vector(arguments, 2, 2);
 	ctr_object* result;
 	ctr_object* numResult;
-	arg1->next = arg2;
-	arg1->object = *((ctr_object**) a);
-	arg2->object = *((ctr_object**) b);
-	result = ctr_block_run(temp_sorter, arg1, NULL);
+	args[0].object = *((ctr_object**) a);
+	args[1].object = *((ctr_object**) b);
+	result = ctr_block_run(temp_sorter, args, NULL);
 	numResult = ctr_internal_cast2number(result);
-	ctr_heap_free( arg1 );
-	ctr_heap_free( arg2 );
 	return (int) numResult->value.nvalue;
 }
 
@@ -751,9 +744,8 @@ ctr_object* ctr_map_type(ctr_object* myself, ctr_argument* argumentList) {
  *
  */
 ctr_object* ctr_map_put(ctr_object* myself, ctr_argument* argumentList) {
-	char* key;
-	long keyLen;
 	ctr_object* putKey;
+	ctr_object* key;
 	ctr_object* putValue = argumentList->object;
 	ctr_argument* nextArgument = argumentList->next;
 	ctr_argument* emptyArgumentList = ctr_heap_allocate(sizeof(ctr_argument));
@@ -767,13 +759,12 @@ ctr_object* ctr_map_put(ctr_object* myself, ctr_argument* argumentList) {
 		putKey = ctr_internal_cast2string(putKey);
 	}
 
-	key = ctr_heap_allocate( putKey->value.svalue->vlen * sizeof( char ) );
-	keyLen = putKey->value.svalue->vlen;
-	memcpy(key, putKey->value.svalue->value, keyLen);
-	ctr_internal_object_delete_property(myself, ctr_build_string(key, keyLen), 0);
-	ctr_internal_object_add_property(myself, ctr_build_string(key, keyLen), putValue, 0);
+	/* the key is copied, the copy takes over the (cached) hash */
+	key = ctr_build_string(putKey->value.svalue->value, putKey->value.svalue->vlen);
+	key->value.svalue->hash = ctr_internal_index_hash(putKey);
+	key->value.svalue->hashed = 1;
+	ctr_internal_object_set_property(myself, key, putValue, 0);
 	ctr_heap_free( emptyArgumentList );
-	ctr_heap_free( key );
 	return myself;
 }
 
@@ -831,6 +822,7 @@ ctr_object* ctr_map_count(ctr_object* myself, ctr_argument* argumentList) {
  * Note that within an each/map block, 'me' and 'my' refer to the collection.
  */
 ctr_object* ctr_map_each(ctr_object* myself, ctr_argument* argumentList) {
+	ctr_argument arguments[3];
 	ctr_object* block = argumentList->object;
 	ctr_mapitem* m;
 	if (block->info.type != CTR_OBJECT_TYPE_OTBLOCK) {
@@ -840,23 +832,15 @@ ctr_object* ctr_map_each(ctr_object* myself, ctr_argument* argumentList) {
 	block->info.sticky = 1;
 	m = myself->properties->head;
 	while(m && !CtrStdFlow) {
-		ctr_argument* arguments = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		ctr_argument* argument2 = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		ctr_argument* argument3 = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		arguments->object = m->key;
-		argument2->object = m->value;
-		argument3->object = myself;
-		arguments->next = argument2;
-		argument2->next = argument3;
-		ctr_block_run(block, arguments, NULL);
+		ctr_argument* a = ctr_argument_vector(arguments, 3, 3);
+		a[0].object = m->key;
+		a[1].object = m->value;
+		a[2].object = myself;
+		ctr_block_run(block, a, NULL);
 		if (CtrStdFlow == CtrStdContinue) CtrStdFlow = NULL;
 		m = m->next;
-		ctr_heap_free( arguments );
-		ctr_heap_free( argument2 );
-		ctr_heap_free( argument3 );
 	}
 	if (CtrStdFlow == CtrStdBreak) CtrStdFlow = NULL;
-	block->info.mark = 0;
 	block->info.sticky = 0;
 	return myself;
 }
@@ -169,6 +169,7 @@
 #define CTR_DICT_STICKY_COUNT	 "stickyCount" 
 #define CTR_DICT_MEMORY_LIMIT	 "memoryLimit:" 
 #define CTR_DICT_MODE            "mode:" 
+#define CTR_DICT_MAX_PAUSE       "maxPause:" 
 #define CTR_DICT_BROOM           "Broom"
 #define CTR_DICT_HASH_WITH_KEY   "hashWithKey:"
 #define CTR_DICT_OBTAIN          "obtain"
@@ -258,6 +259,7 @@
 #define CTR_DICT_FORBID_FORK                     "forbidFork"
 #define CTR_DICT_FORBID_INCLUDE                  "forbidInclude"
 #define CTR_DICT_SET_REMAINING_MESSAGES          "remainingMessages:"
+#define CTR_DICT_MAX_NESTED_CALLS                "maxNestedCalls:"
 #define CTR_DICT_FIND_PATTERN_DO_OPTIONS         "findPattern:do:options:"
 #define CTR_DICT_CONTAINS_PATTERN                "containsPattern:"
 #define CTR_DICT_CONTAINS                        "contains:"
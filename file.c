@@ -211,7 +211,7 @@ ctr_object* ctr_file_include(ctr_object* myself, ctr_argument* argumentList) {
 	parsedCode = ctr_cparse_parse(prg, pathString);
 	ctr_heap_free( prg );
 	ctr_cwlk_subprogram++;
-	ctr_cwlk_run(parsedCode);
+	if (ctr_vm_enabled) ctr_vm_run(parsedCode); else ctr_cwlk_run(parsedCode);
 	ctr_cwlk_subprogram--;
 	return myself;
 }
@@ -22,10 +22,142 @@ memBlock*  memBlocks = NULL;
 size_t     numberOfMemBlocks = 0;
 size_t     maxNumberOfMemBlocks = 0;
 
+/**
+ * Slab, holds small memory blocks of a single size class.
+ *
+ * Objects, maps, map items, arguments and strings are allocated all
+ * the time and they are small, instead of asking malloc for each of
+ * them, blocks up to CTR_SLAB_MAX_BLOCK bytes are carved out of slabs.
+ * Slabs are aligned to their own size, so the slab of a block can be
+ * found by masking its address. Freed blocks go to the free list of
+ * their slab. Slabs that stay empty from one garbage collection to the
+ * next are returned to the system (see ctr_heap_trim).
+ */
+#define CTR_SLAB_SIZE 65536
+#define CTR_SLAB_CLASS_WIDTH 16
+#define CTR_SLAB_MAX_BLOCK 256
+#define CTR_SLAB_CLASSES (CTR_SLAB_MAX_BLOCK / CTR_SLAB_CLASS_WIDTH)
+
+struct slab {
+	struct slab* next;
+	struct slab* prev;
+	char*  free;
+	char*  bump;
+	size_t used;
+	size_t block;
+	int    size_class;
+	int    listed;
+	int    idle;
+};
+
+typedef struct slab slab;
+
+/* slabs per size class that still have room for a block */
+slab*  slabs[CTR_SLAB_CLASSES];
+
+/**
+ * @internal
+ * Links a slab into the list of slabs with room of its size class.
+ */
+void ctr_heap_slab_link( slab* s ) {
+	s->prev = NULL;
+	s->next = slabs[ s->size_class ];
+	if ( s->next ) s->next->prev = s;
+	slabs[ s->size_class ] = s;
+	s->listed = 1;
+}
+
+/**
+ * @internal
+ * Removes a slab from the list of slabs with room of its size class.
+ */
+void ctr_heap_slab_unlink( slab* s ) {
+	if ( s->prev ) s->prev->next = s->next; else slabs[ s->size_class ] = s->next;
+	if ( s->next ) s->next->prev = s->prev;
+	s->listed = 0;
+}
+
+/**
+ * @internal
+ * Takes a zeroed block of the size class that fits the specified
+ * number of bytes from a slab.
+ */
+void* ctr_heap_slab_allocate( size_t size ) {
+	int size_class;
+	char* block;
+	slab* s;
+	size_class = ( size - 1 ) / CTR_SLAB_CLASS_WIDTH;
+	s = slabs[ size_class ];
+	if ( s == NULL ) {
+		if ( posix_memalign( (void**) &s, CTR_SLAB_SIZE, CTR_SLAB_SIZE ) != 0 ) {
+			printf( "Out of memory. Failed to allocate %lu bytes (malloc failed). \n", size );
+			exit(1);
+		}
+		s->free = NULL;
+		s->block = ( size_class + 1 ) * CTR_SLAB_CLASS_WIDTH;
+		s->bump = (char*) s + ( ( sizeof( slab ) + CTR_SLAB_CLASS_WIDTH - 1 ) / CTR_SLAB_CLASS_WIDTH ) * CTR_SLAB_CLASS_WIDTH;
+		s->used = 0;
+		s->size_class = size_class;
+		ctr_heap_slab_link( s );
+	}
+	if ( s->free ) {
+		block = s->free;
+		s->free = *( (char**) block );
+	} else {
+		block = s->bump;
+		s->bump += s->block;
+	}
+	s->used++;
+	s->idle = 0;
+	if ( s->free == NULL && s->bump + s->block > (char*) s + CTR_SLAB_SIZE ) {
+		ctr_heap_slab_unlink( s );
+	}
+	memset( block, 0, s->block );
+	return block;
+}
+
+/**
+ * @internal
+ * Returns a block to its slab.
+ */
+void ctr_heap_slab_free( void* block ) {
+	slab* s;
+	s = (slab*) ( (uintptr_t) block & ~( (uintptr_t) CTR_SLAB_SIZE - 1 ) );
+	*( (char**) block ) = s->free;
+	s->free = (char*) block;
+	s->used--;
+	if ( !s->listed ) ctr_heap_slab_link( s );
+}
+
+/**
+ * Returns empty slabs to the system. Called after every garbage
+ * collection, a slab is returned if it has been empty since the
+ * previous collection, so slabs emptied by a collection can be used
+ * again right away. If all is set, every empty slab is returned.
+ */
+void ctr_heap_trim( int all ) {
+	int i;
+	slab* s;
+	slab* next;
+	for ( i = 0; i < CTR_SLAB_CLASSES; i ++ ) {
+		for ( s = slabs[ i ]; s; s = next ) {
+			next = s->next;
+			if ( s->used > 0 ) continue;
+			if ( s->idle || all ) {
+				ctr_heap_slab_unlink( s );
+				free( s );
+			} else {
+				s->idle = 1;
+			}
+		}
+	}
+}
+
 /**
  * Heap allocate raw memory
  * Allocates a slice of memory having the specified size in bytes.
- * The memory will be zeroed (calloc is used).
+ * The memory will be zeroed (small slices come from a slab, others
+ * are allocated with calloc).
  *
  * If the specified number of bytes cannot be allocated, the program
  * will end with exit 1.
@@ -61,7 +193,11 @@ void* ctr_heap_allocate( size_t size ) {
 	}
 
 	/* Perform allocation and check result */
-	slice_of_memory = calloc( size, 1 );
+	if ( size <= CTR_SLAB_MAX_BLOCK ) {
+		slice_of_memory = ctr_heap_slab_allocate( size );
+	} else {
+		slice_of_memory = calloc( size, 1 );
+	}
 
 	if ( slice_of_memory == NULL ) {
 		printf( "Out of memory. Failed to allocate %lu bytes (malloc failed). \n", size );
@@ -129,6 +265,7 @@ void ctr_heap_free_rest() {
 		ctr_heap_free( memBlocks[i].space );
 	}
 	ctr_heap_free( memBlocks );
+	ctr_heap_trim( 1 );
 }
 
 
@@ -153,7 +290,11 @@ void ctr_heap_free( void* ptr ) {
 	block_width = (size_t*) ptr;
 	size = *(block_width);
 
-	free( ptr );
+	if ( size <= CTR_SLAB_MAX_BLOCK ) {
+		ctr_heap_slab_free( ptr );
+	} else {
+		free( ptr );
+	}
 	ctr_gc_alloc -= size;
 }
 
@@ -182,8 +323,20 @@ void* ctr_heap_reallocate(void* oldptr, size_t size ) {
 
 	/* update the ledger */
 	ctr_gc_alloc = ( ctr_gc_alloc - old_size ) + size;
-	/* re-allocate memory */
-	nptr = realloc( oldptr, size );
+	/* re-allocate memory, small blocks move in or out of the slabs */
+	if ( old_size > CTR_SLAB_MAX_BLOCK && size > CTR_SLAB_MAX_BLOCK ) {
+		nptr = realloc( oldptr, size );
+	} else {
+		nptr = ( size <= CTR_SLAB_MAX_BLOCK ) ? ctr_heap_slab_allocate( size ) : malloc( size );
+		if ( nptr != NULL ) {
+			memcpy( nptr, oldptr, ( old_size < size ) ? old_size : size );
+			if ( old_size <= CTR_SLAB_MAX_BLOCK ) ctr_heap_slab_free( oldptr ); else free( oldptr );
+		}
+	}
+	if ( nptr == NULL ) {
+		printf( "Out of memory. Failed to allocate %lu bytes (realloc failed). \n", size );
+		exit(1);
+	}
 
 	/* store the size of the new block at the beginning */
 	block_width = (size_t*) nptr;
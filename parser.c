@@ -76,6 +76,7 @@ ctr_tnode* ctr_cparse_message(int mode) {
 	}
 	m = ctr_cparse_create_node( CTR_AST_NODE );
 	m->type = -1;
+	m->cache = (ctr_inline_cache*) ctr_heap_allocate_tracked( sizeof( ctr_inline_cache ) );
 	s = ctr_clex_tok_value();
 	msg = ctr_heap_allocate_tracked( 255 * sizeof( char ) );
 	memcpy(msg, s, msgpartlen);
@@ -89,6 +90,8 @@ ctr_tnode* ctr_cparse_message(int mode) {
 		m->type = CTR_AST_NODE_BINMESSAGE;
 		m->value = msg;
 		m->vlen = msgpartlen;
+		m->symbol = ctr_internal_symbol(m->value, m->vlen, 1);
+		m->op = ctr_number_op(m->symbol);
 		li = (ctr_tlistitem*) ctr_heap_allocate_tracked( sizeof(ctr_tlistitem) );
 		li->node = ctr_cparse_expr(2);
 		m->nodes = li;
@@ -147,6 +150,7 @@ ctr_tnode* ctr_cparse_message(int mode) {
 		m->value = msg;
 		m->vlen = msgpartlen;
 	}
+	m->symbol = ctr_internal_symbol(m->value, m->vlen, 1);
 	return m;
 }
 
@@ -258,6 +262,7 @@ ctr_tnode* ctr_cparse_block() {
 		paramItem->value = ctr_heap_allocate_tracked( sizeof( char ) * l );
 		memcpy(paramItem->value, ctr_clex_tok_value(), l);
 		paramItem->vlen = l;
+		paramItem->symbol = ctr_internal_symbol(paramItem->value, l, 1);
 		paramListItem->node = paramItem;
 		if (first) {
 			paramList->nodes = paramListItem;
@@ -354,6 +359,7 @@ ctr_tnode* ctr_cparse_ref() {
 	}
 	r->value = ctr_heap_allocate_tracked( r->vlen );
 	memcpy(r->value, tmp, r->vlen);
+	r->symbol = ctr_internal_symbol(r->value, r->vlen, 1);
 	return r;
 }
 
@@ -387,6 +393,7 @@ ctr_tnode* ctr_cparse_string() {
 void ctr_internal_debug_tree(ctr_tnode* ti, int indent);
 ctr_tnode* ctr_cparse_number() {
 	char* n;
+	char numCStr[41];
 	ctr_tnode* r;
 	long l;
 	ctr_clex_tok();
@@ -397,6 +404,11 @@ ctr_tnode* ctr_cparse_number() {
 	r->value = ctr_heap_allocate_tracked( sizeof( char ) * l );
 	memcpy(r->value, n, l);
 	r->vlen = l;
+	/* decode once, same rules as ctr_build_number_from_string */
+	if (l > 40) l = 40;
+	memcpy(numCStr, n, l);
+	numCStr[l] = '\0';
+	r->nvalue = atof(numCStr);
 	return r;
 }
 
@@ -628,6 +640,191 @@ ctr_tnode* ctr_cparse_program() {
 	return program;
 }
 
+/**
+ * CTRParserResolveCollect
+ *
+ * Collects the names of the variables declared (var) in the scope
+ * of a block, nested blocks have their own scope and are skipped.
+ */
+void ctr_cparse_resolve_collect(ctr_tnode* node, ctr_object** names, int* count) {
+	ctr_tlistitem* li;
+	int i;
+	if (node->type == CTR_AST_NODE_CODEBLOCK) return;
+	if (node->type == CTR_AST_NODE_REFERENCE && node->modifier == 2) {
+		for(i = 0; i < *count; i++) {
+			if (names[i] == node->symbol) return;
+		}
+		if (*count < CTR_MAX_SLOTS) {
+			names[(*count)++] = node->symbol;
+		}
+		return;
+	}
+	li = node->nodes;
+	while(li) {
+		if (li->node) ctr_cparse_resolve_collect(li->node, names, count);
+		li = li->next;
+	}
+}
+
+/**
+ * CTRParserResolveBind
+ *
+ * Binds the references in the scope of a block to the slots of
+ * the variables declared by that block.
+ */
+void ctr_cparse_resolve_bind(ctr_tnode* node, ctr_object** names, int count) {
+	ctr_tlistitem* li;
+	int i;
+	if (node->type == CTR_AST_NODE_CODEBLOCK) return;
+	if (node->type == CTR_AST_NODE_REFERENCE && node->modifier != 1) {
+		for(i = 0; i < count; i++) {
+			if (names[i] == node->symbol) {
+				node->slot = i + 1;
+				break;
+			}
+		}
+		return;
+	}
+	li = node->nodes;
+	while(li) {
+		if (li->node) ctr_cparse_resolve_bind(li->node, names, count);
+		li = li->next;
+	}
+}
+
+/**
+ * CTRParserResolveOrdered
+ *
+ * Returns 1 if none of the variables declared by a block (the names
+ * from first up to count) is referenced before it has been declared.
+ * Declarations in nested blocks belong to those blocks and count as
+ * references.
+ */
+int ctr_cparse_resolve_ordered(ctr_tnode* node, ctr_object** names, int first, int count, char* declared, int nested) {
+	ctr_tlistitem* li;
+	int i;
+	if (node->type == CTR_AST_NODE_CODEBLOCK) nested = 1;
+	if (node->type == CTR_AST_NODE_EXPRASSIGNMENT) {
+		/* the value is evaluated before the variable is declared */
+		if (!ctr_cparse_resolve_ordered(node->nodes->next->node, names, first, count, declared, nested)) return 0;
+		node = node->nodes->node;
+		if (node->modifier == 2 && !nested) {
+			for(i = first; i < count; i++) {
+				if (names[i] == node->symbol) declared[i] = 1;
+			}
+			return 1;
+		}
+	}
+	if (node->type == CTR_AST_NODE_REFERENCE) {
+		if (node->modifier == 1) return 1;
+		for(i = first; i < count; i++) {
+			if (names[i] == node->symbol) return declared[i];
+		}
+		return 1;
+	}
+	li = node->nodes;
+	while(li) {
+		if (li->node && !ctr_cparse_resolve_ordered(li->node, names, first, count, declared, nested)) return 0;
+		li = li->next;
+	}
+	return 1;
+}
+
+/**
+ * CTRParserResolveReceives
+ *
+ * Returns 1 if a message other than a binary arithmetic or
+ * comparison message is sent to the variable itself, such a
+ * message might change the number in the variable.
+ */
+int ctr_cparse_resolve_receives(ctr_tnode* node, ctr_object* name) {
+	ctr_tlistitem* li;
+	ctr_tnode* receiver;
+	ctr_tnode* message;
+	if (node->type == CTR_AST_NODE_EXPRMESSAGE) {
+		receiver = node->nodes->node;
+		while(receiver->type == CTR_AST_NODE_NESTED) receiver = receiver->nodes->node;
+		if (receiver->type == CTR_AST_NODE_REFERENCE && receiver->modifier != 1 && receiver->symbol == name) {
+			message = node->nodes->next ? node->nodes->next->node : NULL;
+			if (!message || message->type != CTR_AST_NODE_BINMESSAGE || message->op == 0) return 1;
+		}
+	}
+	li = node->nodes;
+	while(li) {
+		if (li->node && ctr_cparse_resolve_receives(li->node, name)) return 1;
+		li = li->next;
+	}
+	return 0;
+}
+
+/**
+ * CTRParserResolve
+ *
+ * Resolves the local variables of all blocks in the tree.
+ * Every block gets a slot for each parameter and each variable
+ * declared with var, references to these variables inside the
+ * block itself are bound to the slot. Variables are still
+ * scoped dynamically: a reference inside a nested block or to an
+ * undeclared variable is looked up by name at runtime.
+ */
+void ctr_cparse_resolve(ctr_tnode* node) {
+	ctr_object* names[CTR_MAX_SLOTS];
+	char declared[CTR_MAX_SLOTS];
+	int count = 0;
+	int parameters;
+	ctr_tlistitem* li;
+	ctr_tlistitem* param;
+	ctr_tlistitem* code;
+	if (node->type == CTR_AST_NODE_CODEBLOCK) {
+		param = node->nodes->node->nodes;
+		code = node->nodes->next->node->nodes;
+		while(param) {
+			if (count < CTR_MAX_SLOTS) {
+				names[count] = param->node->symbol;
+				param->node->slot = ++count;
+			}
+			param = param->next;
+		}
+		parameters = count;
+		li = code;
+		while(li) {
+			if (li->node) ctr_cparse_resolve_collect(li->node, names, &count);
+			li = li->next;
+		}
+		li = code;
+		while(li) {
+			if (li->node) ctr_cparse_resolve_bind(li->node, names, count);
+			li = li->next;
+		}
+		node->slot = count;
+		node->flags = CTR_BLOCK_REUSABLE_FRAME | CTR_BLOCK_SHARED_PARAMETER;
+		memset(declared, 0, sizeof(declared));
+		li = code;
+		while(li) {
+			if (li->node && !ctr_cparse_resolve_ordered(li->node, names, parameters, count, declared, 0)) {
+				node->flags &= ~CTR_BLOCK_REUSABLE_FRAME;
+				break;
+			}
+			li = li->next;
+		}
+		li = code;
+		while(li && parameters > 0) {
+			if (li->node && ctr_cparse_resolve_receives(li->node, names[0])) {
+				node->flags &= ~CTR_BLOCK_SHARED_PARAMETER;
+				break;
+			}
+			li = li->next;
+		}
+		li = code;
+	} else {
+		li = node->nodes;
+	}
+	while(li) {
+		if (li->node) ctr_cparse_resolve(li->node);
+		li = li->next;
+	}
+}
+
 /**
  * CTRParserStart
  *
@@ -641,5 +838,6 @@ ctr_tnode*  ctr_cparse_parse(char* prg, char* pathString) {
 	program->value = pathString;
 	program->vlen = strlen(pathString);
 	program->type = CTR_AST_NODE_PROGRAM;
+	ctr_cparse_resolve(program);
 	return program;
 }
@@ -53,6 +53,20 @@ for i in $(find tests -name 'test*.ctr'); do
 		echo $result
 		exit 1
 	fi
+	echo -n "$fitem bytecode";
+	result=`echo "test" | ./ctr -b ${fitem}`
+	if [ "$result" = "$expected" ]; then
+		echo "[$j]"
+		j=$((j+1))
+	else
+		echo "FAIL."
+		echo "EXPECTED:"
+		echo $expected
+		echo ""
+		echo "BUT GOT:"
+		echo $result
+		exit 1
+	fi
 	headline=$(head -n 1 $fitem)
 done
 echo ""
@@ -25,52 +25,186 @@
 
 /**
  * @internal
- * GarbageCollector Marker
+ * Doubles the size of the gray stack.
  */
-void ctr_gc_mark(ctr_object* object) {
-	ctr_object* el;
+void ctr_gc_grow() {
+	ctr_gc_gray_size *= 2;
+	ctr_gc_gray = ctr_heap_reallocate_tracked( ctr_gc_gray_tracking_id, ctr_gc_gray_size * sizeof( ctr_gc_frame ) );
+}
+
+/**
+ * @internal
+ * Pushes an object onto the gray stack, it will be scanned from the
+ * start.
+ */
+void ctr_gc_push(ctr_object* object) {
+	ctr_gc_frame* frame;
+	if (ctr_gc_gray_count == ctr_gc_gray_size) ctr_gc_grow();
+	frame = ctr_gc_gray + ctr_gc_gray_count++;
+	frame->object = object;
+	frame->item = NULL;
+	frame->index = 0;
+	frame->phase = 0;
+	frame->step = ctr_gc_step;
+}
+
+/**
+ * @internal
+ * GarbageCollector Shade
+ *
+ * Marks a white object. Objects that do not refer to other objects
+ * are black right away, others are gray and pushed onto the gray stack.
+ * While collecting young objects, old objects are left alone.
+ */
+void ctr_gc_shade(ctr_object* object) {
+	if (object->info.mark || (ctr_gc_young && object->info.old)) return;
+	object->info.mark = 1;
+	if (object->info.type != CTR_OBJECT_TYPE_OTARRAY && object->properties->head == NULL && object->methods->head == NULL) return;
+	ctr_gc_push(object);
+}
+
+/**
+ * @internal
+ * GarbageCollector Scan
+ *
+ * Continues scanning the object in the frame, marks the objects it
+ * refers to and returns the first one that is gray, so it can be
+ * scanned before the rest (keeping related objects close together in
+ * the cache). Returns NULL once the object has been scanned entirely.
+ * Keys are strings, they are marked black right away.
+ */
+ctr_object* ctr_gc_scan(ctr_gc_frame* frame) {
+	ctr_object* object = frame->object;
+	ctr_object** elements;
 	ctr_mapitem* item;
 	ctr_object* o;
-	ctr_object* k;
-	long i;
-	if (object->info.type == CTR_OBJECT_TYPE_OTARRAY) {
-		for (i = 0; i < object->value.avalue->head; i++) {
-			el = *(object->value.avalue->elements+i);
-			el->info.mark = 1;
-			ctr_gc_mark(el);
+	long n;
+	if (frame->step != ctr_gc_step) {
+		/* the program has run since the previous step, items might be gone */
+		if (frame->phase == 1) frame->item = object->properties->head;
+		if (frame->phase == 2) frame->item = object->methods->head;
+		frame->step = ctr_gc_step;
+	}
+	if (frame->phase == 0) {
+		if (object->info.type == CTR_OBJECT_TYPE_OTARRAY) {
+			elements = object->value.avalue->elements;
+			n = object->value.avalue->head;
+			while (frame->index < n) {
+				if (frame->index + CTR_GC_PREFETCH_DISTANCE < n) ctr_gc_prefetch(elements[frame->index + CTR_GC_PREFETCH_DISTANCE]);
+				o = elements[frame->index++];
+				if (o->info.mark || (ctr_gc_young && o->info.old)) continue;
+				o->info.mark = 1;
+				if (o->info.type != CTR_OBJECT_TYPE_OTARRAY && o->properties->head == NULL && o->methods->head == NULL) continue;
+				return o;
+			}
+		}
+		frame->phase = 1;
+		frame->item = object->properties->head;
+	}
+	while (frame->phase < 3) {
+		item = frame->item;
+		while (item) {
+			if (item->next) ctr_gc_prefetch(item->next);
+			if (!ctr_gc_young || !item->key->info.old) item->key->info.mark = 1;
+			o = item->value;
+			item = item->next;
+			if (o->info.mark || (ctr_gc_young && o->info.old)) continue;
+			o->info.mark = 1;
+			if (o->info.type != CTR_OBJECT_TYPE_OTARRAY && o->properties->head == NULL && o->methods->head == NULL) continue;
+			frame->item = item;
+			return o;
 		}
+		frame->phase++;
+		frame->item = (frame->phase == 2) ? object->methods->head : NULL;
 	}
-	item = object->properties->head;
-	while(item) {
-		k = item->key;
-		o = item->value;
-		o->info.mark = 1;
-		k->info.mark = 1;
-		ctr_gc_mark(o);
-		item = item->next;
-	} 
-	item = object->methods->head;
-	while(item) {
-		o = item->value;
-		k = item->key;
-		o->info.mark = 1;
-		k->info.mark = 1;
-		ctr_gc_mark(o);
-		item = item->next;
-	} 
+	return NULL;
+}
+
+/**
+ * @internal
+ * GarbageCollector Drain
+ *
+ * Scans gray objects until at most budget of them have been scanned
+ * entirely (0 means no limit), returns 1 if there are no gray objects
+ * left.
+ */
+int ctr_gc_drain(int budget) {
+	ctr_object* o;
+	int n = 0;
+	ctr_gc_step++;
+	while(ctr_gc_gray_count > 0) {
+		o = ctr_gc_scan(ctr_gc_gray + ctr_gc_gray_count - 1);
+		if (o) {
+			ctr_gc_push(o);
+			continue;
+		}
+		ctr_gc_gray_count--;
+		if (budget && ++n >= budget) break;
+	}
+	return (ctr_gc_gray_count == 0);
+}
+
+/**
+ * @internal
+ * GarbageCollector Marker
+ *
+ * Marks all objects reachable from the specified object, the object
+ * itself is not marked. Instead of recursing, the objects being
+ * scanned are kept on the gray stack, objects already marked are
+ * skipped.
+ */
+void ctr_gc_mark(ctr_object* object) {
+	ctr_gc_push(object);
+	ctr_gc_drain(0);
+}
+
+/**
+ * @internal
+ * GarbageCollector Write Barrier
+ *
+ * Remembers an old object that receives a reference to a young one,
+ * so the next young collection will treat it as a root. While marking
+ * incrementally, the stored object is shaded so a black owner never
+ * refers to a white object.
+ */
+void ctr_gc_write_barrier(ctr_object* owner, ctr_object* value) {
+	if (ctr_gc_marking && !value->info.mark) ctr_gc_shade(value);
+	if (!owner->info.old || value->info.old || owner->info.remembered) return;
+	owner->info.remembered = 1;
+	if (ctr_gc_remembered_count == ctr_gc_remembered_size) {
+		ctr_gc_remembered_size *= 2;
+		ctr_gc_remembered = ctr_heap_reallocate_tracked( ctr_gc_remembered_tracking_id, ctr_gc_remembered_size * sizeof( ctr_object* ) );
+	}
+	ctr_gc_remembered[ctr_gc_remembered_count++] = owner;
+}
+
+/**
+ * @internal
+ * Forgets all remembered objects.
+ */
+void ctr_gc_forget() {
+	int i;
+	for(i = 0; i < ctr_gc_remembered_count; i++) {
+		ctr_gc_remembered[i]->info.remembered = 0;
+	}
+	ctr_gc_remembered_count = 0;
 }
 
 /**
  * @internal
  * GarbageCollector Sweeper
+ *
+ * Sweeps the object list up to (not including) the end object,
+ * objects that survive become old.
  */
-void ctr_gc_sweep( int all ) {
+void ctr_gc_sweep( int all, ctr_object* end ) {
 	ctr_object* previousObject = NULL;
 	ctr_object* currentObject = ctr_first_object;
 	ctr_object* nextObject = NULL;
 	ctr_mapitem* mapItem = NULL;
 	ctr_mapitem* tmp = NULL;
-	while(currentObject) {
+	int swept = 0;
+	while(currentObject && currentObject != end) {
 		ctr_gc_object_counter ++;
 		if ( ( currentObject->info.mark==0 && currentObject->info.sticky==0 ) || all){
 			ctr_gc_dust_counter ++;
@@ -100,7 +234,9 @@ void ctr_gc_sweep( int all ) {
 					mapItem = tmp;
 				}
 			}
-			if (currentObject->properties->head) {
+			if (currentObject->properties->items) {
+				ctr_heap_free( currentObject->properties->items );
+			} else if (currentObject->properties->head) {
 				mapItem = currentObject->properties->head;
 				while(mapItem) {
 					tmp = mapItem->next;
@@ -108,15 +244,26 @@ void ctr_gc_sweep( int all ) {
 					mapItem = tmp;
 				}
 			}
-			ctr_heap_free( currentObject->methods );
-			ctr_heap_free( currentObject->properties );
+			if (currentObject->methods->index) {
+				ctr_heap_free( currentObject->methods->index );
+			}
+			if (currentObject->properties->index) {
+				ctr_heap_free( currentObject->properties->index );
+			}
+			if (currentObject->methods != &ctr_map_no_methods) ctr_heap_free( currentObject->methods );
+			if (currentObject->properties != &ctr_map_no_properties) ctr_heap_free( currentObject->properties );
 			switch (currentObject->info.type) {
 				case CTR_OBJECT_TYPE_OTSTRING:
 					if (currentObject->value.svalue != NULL) {
-						if (currentObject->value.svalue->vlen > 0) {
-							ctr_heap_free( currentObject->value.svalue->value );
+						if (currentObject->value.svalue->shared > 0) {
+							/* bytes still in use by another string */
+							currentObject->value.svalue->shared--;
+						} else {
+							if (currentObject->value.svalue->vlen > 0) {
+								ctr_heap_free( currentObject->value.svalue->value );
+							}
+							ctr_heap_free( currentObject->value.svalue );
 						}
-						ctr_heap_free( currentObject->value.svalue );
 					}
 				break;
 				case CTR_OBJECT_TYPE_OTARRAY:
@@ -128,6 +275,7 @@ void ctr_gc_sweep( int all ) {
 				break;
 			}
 			ctr_heap_free( currentObject );
+			swept = 1;
 			currentObject = nextObject;
 		} else {
 			ctr_gc_kept_counter ++;
@@ -135,10 +283,13 @@ void ctr_gc_sweep( int all ) {
 			if (currentObject->info.mark == 1) {
 				currentObject->info.mark = 0;
 			}
+			currentObject->info.old = 1;
 			previousObject = currentObject;
 			currentObject = currentObject->gnext;
 		}
 	}
+	if (swept) ctr_method_epoch++; /* memory might be reused, invalidate inline caches */
+	ctr_heap_trim( 0 ); /* return slabs nobody needed since the previous sweep */
 }
 
 /**
@@ -147,22 +298,146 @@ void ctr_gc_sweep( int all ) {
  */
 void  ctr_gc_internal_collect() {
 	ctr_object* context;
+	ctr_object* o;
 	int oldcid;
+	int i;
 	ctr_gc_dust_counter = 0;
 	ctr_gc_object_counter = 0;
 	ctr_gc_kept_counter = 0;
 	ctr_gc_sticky_counter = 0;
-	context = ctr_contexts[ctr_context_id];
+	/* remembered objects might be swept, everything left will be old */
+	ctr_gc_forget();
+	/* abandon incremental marking, objects marked so far might be dust */
+	if (ctr_gc_marking) {
+		ctr_gc_marking = 0;
+		ctr_gc_gray_count = 0;
+		for(o = ctr_first_object; o; o = o->gnext) o->info.mark = 0;
+	}
 	oldcid = ctr_context_id;
 	while(ctr_context_id > -1) {
+		context = ctr_contexts[ctr_context_id];
 		ctr_gc_mark(context);
 		ctr_context_id--;
-		context = ctr_contexts[ctr_context_id];
 	}
-	ctr_gc_sweep( 0 );
+	/* intermediate values of the VM */
+	for(i = 0; i < ctr_vm_top; i++) {
+		if (ctr_vm_stack[i] == NULL) continue;
+		ctr_gc_shade(ctr_vm_stack[i]);
+	}
+	ctr_gc_drain( 0 );
+	ctr_gc_sweep( 0, NULL );
+	ctr_gc_old_objects = ctr_first_object;
 	ctr_context_id = oldcid;
 }
 
+/**
+ * @internal
+ * Garbage Collector young sweep.
+ *
+ * Only sweeps the objects created since the latest collection, the
+ * contexts, the VM stack and the remembered objects are the roots.
+ */
+void ctr_gc_internal_collect_young() {
+	ctr_object* o;
+	int i;
+	ctr_gc_dust_counter = 0;
+	ctr_gc_object_counter = 0;
+	ctr_gc_kept_counter = 0;
+	ctr_gc_sticky_counter = 0;
+	ctr_gc_young = 1;
+	for(i = 0; i <= ctr_context_id; i++) {
+		o = ctr_contexts[i];
+		if (!o->info.old) o->info.mark = 1;
+		ctr_gc_push(o);
+	}
+	for(i = 0; i < ctr_vm_top; i++) {
+		if (ctr_vm_stack[i] == NULL) continue;
+		ctr_gc_shade(ctr_vm_stack[i]);
+	}
+	for(i = 0; i < ctr_gc_remembered_count; i++) {
+		ctr_gc_push(ctr_gc_remembered[i]);
+	}
+	ctr_gc_drain( 0 );
+	ctr_gc_young = 0;
+	ctr_gc_forget();
+	ctr_gc_sweep( 0, ctr_gc_old_objects );
+	ctr_gc_old_objects = ctr_first_object;
+}
+
+/**
+ * @internal
+ * Garbage Collector incremental sweep, start.
+ *
+ * Shades the roots, the marking itself is spread over the next steps.
+ */
+void ctr_gc_internal_collect_start() {
+	int i;
+	ctr_gc_marking = 1;
+	ctr_gc_gray_count = 0;
+	for(i = 0; i <= ctr_context_id; i++) {
+		ctr_gc_shade(ctr_contexts[i]);
+	}
+	for(i = 0; i < ctr_vm_top; i++) {
+		if (ctr_vm_stack[i] == NULL) continue;
+		ctr_gc_shade(ctr_vm_stack[i]);
+	}
+}
+
+/**
+ * @internal
+ * Garbage Collector incremental sweep, step.
+ *
+ * Scans at most ctr_gc_max_pause gray objects. Once all of them have
+ * been scanned, the roots are scanned again because variables are
+ * assigned without a write barrier, then the heap is swept. If memory
+ * is about to run out, the marking is finished right away.
+ */
+void ctr_gc_internal_collect_step() {
+	int i;
+	int budget = ctr_gc_max_pause;
+	if ( ctr_gc_alloc > ( ctr_gc_memlimit * 0.95 ) ) budget = 0;
+	if ( !ctr_gc_drain( budget ) ) return;
+	for(i = 0; i <= ctr_context_id; i++) {
+		ctr_gc_push(ctr_contexts[i]);
+	}
+	for(i = 0; i < ctr_vm_top; i++) {
+		if (ctr_vm_stack[i] == NULL) continue;
+		ctr_gc_shade(ctr_vm_stack[i]);
+	}
+	ctr_gc_drain( 0 );
+	ctr_gc_marking = 0;
+	ctr_gc_dust_counter = 0;
+	ctr_gc_object_counter = 0;
+	ctr_gc_kept_counter = 0;
+	ctr_gc_sticky_counter = 0;
+	ctr_gc_forget();
+	ctr_gc_sweep( 0, NULL );
+	ctr_gc_old_objects = ctr_first_object;
+}
+
+/**
+ * @internal
+ * Automatic garbage collection, sweeps the young objects and only
+ * sweeps everything if that did not free enough memory. If a maximum
+ * pause has been set, sweeping everything is done incrementally, young
+ * objects are not swept separately until that has been completed.
+ */
+void ctr_gc_internal_collect_auto() {
+	if ( ctr_gc_marking ) {
+		ctr_gc_internal_collect_step();
+		return;
+	}
+	ctr_gc_internal_collect_young();
+	if ( ( ctr_gc_mode & 1 ) && ctr_gc_alloc > ( ctr_gc_memlimit * 0.8 ) ) {
+		if ( ctr_gc_max_pause > 0 ) {
+			ctr_gc_internal_collect_start();
+			ctr_gc_internal_collect_step();
+		} else {
+			ctr_gc_internal_collect();
+		}
+	}
+}
+
 /**
  * Broom
  *
@@ -243,12 +518,35 @@ ctr_object* ctr_gc_setmemlimit(ctr_object* myself, ctr_argument* argumentList) {
  * 0 - No Garbage Collection
  * 1 - Activate Garbage Collector
  * 4 - Activate Garbage Collector for every single step (testing only)
+ *
+ * The automatic collector only sweeps the objects created since the
+ * previous collection, unless memory is still running low after that.
+ * To sweep all objects use: Broom sweep.
  */
 ctr_object* ctr_gc_setmode(ctr_object* myself, ctr_argument* argumentList) {
 	ctr_gc_mode = (int) ctr_internal_cast2number( argumentList->object )->value.nvalue;
 	return myself;
 }
 
+/**
+ * [Broom] maxPause: [Number]
+ *
+ * Sets the maximum number of objects the automatic garbage collector
+ * will mark after a single step of the program. If memory gets low,
+ * the objects will be marked a few at a time instead of all at once,
+ * so the program will not be paused for a long time. Set to 0 (the
+ * default) to mark all objects at once.
+ *
+ * Usage:
+ *
+ * Broom maxPause: 1000.
+ */
+ctr_object* ctr_gc_setmaxpause(ctr_object* myself, ctr_argument* argumentList) {
+	ctr_gc_max_pause = (int) ctr_internal_cast2number( argumentList->object )->value.nvalue;
+	if (ctr_gc_max_pause < 0) ctr_gc_max_pause = 0;
+	return myself;
+}
+
 /**
  * [Shell] call: [String]
  *
@@ -703,6 +1001,25 @@ ctr_object* ctr_command_countdown( ctr_object* myself, ctr_argument* argumentLis
 	return myself;
 }
 
+/**
+ * [Program] maxNestedCalls: [Number]
+ *
+ * Limits the number of nested calls (blocks and methods running
+ * inside each other). Once the limit has been reached, the next call
+ * raises the error 'Too many nested calls.'. Without a limit (or if it
+ * is set to 0) calls can be nested as long as there is room on the
+ * stack.
+ *
+ * Usage:
+ *
+ * Program maxNestedCalls: 1000.
+ */
+ctr_object* ctr_command_max_nested_calls( ctr_object* myself, ctr_argument* argumentList ) {
+	ctr_context_max_depth = (int) ctr_internal_cast2number( argumentList->object )->value.nvalue;
+	if (ctr_context_max_depth < 0) ctr_context_max_depth = 0;
+	return myself;
+}
+
 /**
  * [Program] flush.
  *
@@ -0,0 +1,358 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "citrine.h"
+
+/**
+ * Bytecode compiler and virtual machine.
+ *
+ * The compiler turns the instruction lists of a program and of all
+ * of its code blocks into a flat list of instructions. The virtual
+ * machine runs these instructions on a value stack, the semantics are
+ * the same as those of the tree walker (walker.c) which remains the
+ * default. Use the -b command line switch to run a program on the VM.
+ */
+
+/**
+ * Instruction buffer used while compiling.
+ */
+struct ctr_vm_compiler {
+	ctr_instruction* instructions;
+	int length;
+	int size;
+	int depth;
+	int maxDepth;
+};
+typedef struct ctr_vm_compiler ctr_vm_compiler;
+
+void ctr_vm_compile_expr(ctr_vm_compiler* c, ctr_tnode* node, int statement);
+
+/**
+ * @internal
+ *
+ * VMEmit
+ *
+ * Appends an instruction, effect is the change in stack depth.
+ */
+void ctr_vm_emit(ctr_vm_compiler* c, uint8_t op, uint8_t argc, ctr_tnode* node, int effect) {
+	ctr_instruction* instruction;
+	if (c->length == c->size) {
+		c->size = c->size * 2;
+		c->instructions = ctr_heap_reallocate(c->instructions, c->size * sizeof(ctr_instruction));
+	}
+	instruction = c->instructions + c->length;
+	instruction->op = op;
+	instruction->argc = argc;
+	instruction->node = node;
+	c->length++;
+	c->depth += effect;
+	if (c->depth > c->maxDepth) c->maxDepth = c->depth;
+}
+
+/**
+ * @internal
+ *
+ * VMCompileMessage
+ *
+ * Compiles a receiver followed by a chain of messages. If tail
+ * is set, the last message is sent as a possible tail call.
+ */
+void ctr_vm_compile_message(ctr_vm_compiler* c, ctr_tnode* node, int tail) {
+	ctr_tlistitem* li = node->nodes;
+	ctr_tnode* receiverNode = li->node;
+	ctr_tlistitem* argumentList;
+	int argc;
+	if (receiverNode->type == CTR_AST_NODE_REFERENCE) {
+		/* a missing receiver is fatal */
+		ctr_vm_emit(c, CTR_OP_LOAD, 1, receiverNode, 1);
+	} else {
+		ctr_vm_compile_expr(c, receiverNode, 0);
+	}
+	while(li->next) {
+		li = li->next;
+		ctr_vm_emit(c, CTR_OP_MARK, 0, li->node, 0);
+		argc = 0;
+		argumentList = li->node->nodes;
+		while(argumentList) {
+			ctr_vm_compile_expr(c, argumentList->node, 0);
+			argc++;
+			argumentList = argumentList->next;
+		}
+		if (argc > 255) {
+			printf("Too many arguments.\n");
+			exit(1);
+		}
+		ctr_vm_emit(c, (tail && !li->next) ? CTR_OP_TAILSEND : CTR_OP_SEND, argc, li->node, -argc);
+	}
+}
+
+/**
+ * @internal
+ *
+ * VMCompileExpression
+ *
+ * Compiles an expression, leaving its value on the stack.
+ * Only a return at statement level ends the block.
+ */
+void ctr_vm_compile_expr(ctr_vm_compiler* c, ctr_tnode* node, int statement) {
+	ctr_tnode* returnNode;
+	switch (node->type) {
+		case CTR_AST_NODE_LTRSTRING:
+			ctr_vm_emit(c, CTR_OP_PUSH_STRING, 0, node, 1);
+			break;
+		case CTR_AST_NODE_LTRBOOLTRUE:
+			ctr_vm_emit(c, CTR_OP_PUSH_TRUE, 0, node, 1);
+			break;
+		case CTR_AST_NODE_LTRBOOLFALSE:
+			ctr_vm_emit(c, CTR_OP_PUSH_FALSE, 0, node, 1);
+			break;
+		case CTR_AST_NODE_LTRNIL:
+			ctr_vm_emit(c, CTR_OP_PUSH_NIL, 0, node, 1);
+			break;
+		case CTR_AST_NODE_LTRNUM:
+			ctr_vm_emit(c, CTR_OP_PUSH_NUMBER, 0, node, 1);
+			break;
+		case CTR_AST_NODE_CODEBLOCK:
+			ctr_vm_compile(node->nodes->next->node);
+			ctr_vm_emit(c, CTR_OP_PUSH_BLOCK, 0, node, 1);
+			break;
+		case CTR_AST_NODE_REFERENCE:
+			ctr_vm_emit(c, CTR_OP_LOAD, 0, node, 1);
+			break;
+		case CTR_AST_NODE_EXPRMESSAGE:
+			ctr_vm_compile_message(c, node, 0);
+			break;
+		case CTR_AST_NODE_EXPRASSIGNMENT:
+			ctr_vm_emit(c, CTR_OP_MARK, 0, node->nodes->node, 0);
+			ctr_vm_compile_expr(c, node->nodes->next->node, 0);
+			ctr_vm_emit(c, CTR_OP_STORE, 0, node->nodes->node, 0);
+			break;
+		case CTR_AST_NODE_RETURNFROMBLOCK:
+			if (!node->nodes || !node->nodes->node) {
+				printf("Invalid return expression.\n");
+				exit(1);
+			}
+			returnNode = node->nodes->node;
+			while (returnNode->type == CTR_AST_NODE_NESTED) returnNode = returnNode->nodes->node;
+			if (statement && returnNode->type == CTR_AST_NODE_EXPRMESSAGE) {
+				ctr_vm_compile_message(c, returnNode, 1);
+			} else {
+				ctr_vm_compile_expr(c, node->nodes->node, 0);
+			}
+			if (statement) ctr_vm_emit(c, CTR_OP_RETURN, 0, node, 0);
+			break;
+		case CTR_AST_NODE_NESTED:
+			ctr_vm_compile_expr(c, node->nodes->node, statement);
+			break;
+		case CTR_AST_NODE_ENDOFPROGRAM:
+			ctr_vm_emit(c, CTR_OP_END, 0, node, 1);
+			break;
+		default:
+			printf("Runtime Error. Invalid parse node: %d %s \n", node->type,node->value);
+			exit(1);
+			break;
+	}
+}
+
+/**
+ * @internal
+ *
+ * VMCompile
+ *
+ * Compiles a program or the instruction list of a code block,
+ * including all nested code blocks. The result is stored in
+ * the node itself.
+ */
+void ctr_vm_compile(ctr_tnode* program) {
+	ctr_vm_compiler c;
+	ctr_tlistitem* li;
+	ctr_bytecode* code;
+	if (program->code) return;
+	c.size = 16;
+	c.length = 0;
+	c.depth = 0;
+	c.maxDepth = 0;
+	c.instructions = ctr_heap_allocate(c.size * sizeof(ctr_instruction));
+	li = program->nodes;
+	while(li) {
+		if (!li->node) {
+			printf("Missing parse node\n");
+			exit(1);
+		}
+		ctr_vm_compile_expr(&c, li->node, 1);
+		ctr_vm_emit(&c, CTR_OP_POP, 0, li->node, -1);
+		li = li->next;
+	}
+	ctr_vm_emit(&c, CTR_OP_HALT, 0, program, 0);
+	code = ctr_heap_allocate_tracked(sizeof(ctr_bytecode));
+	code->length = c.length;
+	code->depth = c.maxDepth;
+	code->instructions = ctr_heap_allocate_tracked(c.length * sizeof(ctr_instruction));
+	memcpy(code->instructions, c.instructions, c.length * sizeof(ctr_instruction));
+	ctr_heap_free(c.instructions);
+	program->code = code;
+}
+
+/**
+ * @internal
+ *
+ * VMSend
+ *
+ * Sends a message with argc arguments from the top of the stack
+ * to the receiver below them, tail as in ctr_send_message_dispatch.
+ */
+ctr_object* ctr_vm_send(ctr_tnode* msgnode, int argc, int tail) {
+	ctr_argument arguments[CTR_ARGUMENT_VECTOR_SIZE];
+	ctr_object* r = ctr_vm_stack[ctr_vm_top - argc - 1];
+	ctr_object* result;
+	ctr_argument* a;
+	int sticky;
+	int i;
+	/* there is always an extra empty argument at the end */
+	a = ctr_argument_vector(arguments, CTR_ARGUMENT_VECTOR_SIZE, argc + 1);
+	for(i = 0; i < argc; i++) {
+		a[i].object = ctr_vm_stack[ctr_vm_top - argc + i];
+	}
+	sticky = r->info.sticky;
+	r->info.sticky = 1;
+	result = ctr_send_message_dispatch(r, msgnode->symbol, a, msgnode->cache, tail);
+	r->info.sticky = sticky;
+	if (CtrStdFlow == NULL) {
+		ctr_callstack_index --;
+	}
+	ctr_argument_vector_free(arguments, a);
+	return result;
+}
+
+/**
+ * @internal
+ *
+ * VMRun
+ *
+ * Runs a program or the instruction list of a code block.
+ * Like ctr_cwlk_run, returns NULL unless the code returned a value.
+ */
+ctr_object* ctr_vm_run(ctr_tnode* program) {
+	return ctr_vm_run_body(program, 0);
+}
+
+/**
+ * @internal
+ *
+ * VMRunBody
+ *
+ * Runs a program or the instruction list of a code block, only
+ * ctr_block_run sets tail to allow tail calls.
+ */
+ctr_object* ctr_vm_run_body(ctr_tnode* program, int tail) {
+	ctr_bytecode* code;
+	ctr_instruction* ip;
+	ctr_tnode* node;
+	ctr_object* result;
+	int base;
+	if (!program->code) ctr_vm_compile(program);
+	code = program->code;
+	if (ctr_vm_stack == NULL) {
+		ctr_vm_stack_size = 256;
+		ctr_vm_stack = ctr_heap_allocate_tracked( ctr_vm_stack_size * sizeof( ctr_object* ) );
+		ctr_vm_stack_tracking_id = ctr_heap_get_latest_tracking_id();
+	}
+	if (ctr_vm_top + code->depth > ctr_vm_stack_size) {
+		while(ctr_vm_stack_size < ctr_vm_top + code->depth) ctr_vm_stack_size *= 2;
+		ctr_vm_stack = ctr_heap_reallocate_tracked( ctr_vm_stack_tracking_id, ctr_vm_stack_size * sizeof( ctr_object* ) );
+	}
+	base = ctr_vm_top;
+	ip = code->instructions;
+	while(1) {
+		node = ip->node;
+		switch(ip->op) {
+			case CTR_OP_PUSH_NIL:
+				ctr_vm_stack[ctr_vm_top++] = ctr_build_nil();
+				break;
+			case CTR_OP_PUSH_TRUE:
+				ctr_vm_stack[ctr_vm_top++] = ctr_build_bool(1);
+				break;
+			case CTR_OP_PUSH_FALSE:
+				ctr_vm_stack[ctr_vm_top++] = ctr_build_bool(0);
+				break;
+			case CTR_OP_PUSH_NUMBER:
+				ctr_vm_stack[ctr_vm_top++] = ctr_build_number_from_float(node->nvalue);
+				break;
+			case CTR_OP_PUSH_STRING:
+				ctr_vm_stack[ctr_vm_top++] = ctr_build_string(node->value, node->vlen);
+				break;
+			case CTR_OP_PUSH_BLOCK:
+				ctr_vm_stack[ctr_vm_top++] = ctr_build_block(node);
+				break;
+			case CTR_OP_LOAD:
+				if (CtrStdFlow == NULL) {
+					ctr_callstack_push(node);
+				}
+				if (node->modifier == 1) {
+					result = ctr_find_in_my(node->symbol, node);
+				} else {
+					result = ctr_find_slot(node->symbol, node->slot);
+				}
+				if (CtrStdFlow == NULL) {
+					ctr_callstack_index--;
+				}
+				if (ip->argc && !result) {
+					exit(1);
+				}
+				ctr_vm_stack[ctr_vm_top++] = result;
+				break;
+			case CTR_OP_MARK:
+				if (CtrStdFlow == NULL) {
+					ctr_callstack_push(node);
+				}
+				break;
+			case CTR_OP_STORE:
+				result = ctr_vm_stack[ctr_vm_top - 1];
+				if (node->modifier == 1) {
+					result = ctr_assign_value_to_my(node->symbol, result, node);
+				} else {
+					result = ctr_assign_value_to_slot(node->symbol, result, node->slot, (node->modifier == 2));
+				}
+				if (CtrStdFlow == NULL) {
+					ctr_callstack_index--;
+				}
+				ctr_vm_stack[ctr_vm_top - 1] = result;
+				break;
+			case CTR_OP_SEND:
+			case CTR_OP_TAILSEND:
+				result = NULL;
+				if (node->op) {
+					result = ctr_number_op_apply(node->op, ctr_vm_stack[ctr_vm_top - 2], ctr_vm_stack[ctr_vm_top - 1]);
+					if (result && CtrStdFlow == NULL) ctr_callstack_index--;
+				}
+				if (result == NULL) result = ctr_vm_send(node, ip->argc, tail && ip->op == CTR_OP_TAILSEND);
+				ctr_vm_top -= ip->argc;
+				ctr_vm_stack[ctr_vm_top - 1] = result;
+				break;
+			case CTR_OP_POP:
+				ctr_vm_top--;
+				/* Perform garbage collection cycle */
+				if ( ( ( ctr_gc_mode & 1 ) && ctr_gc_alloc > ( ctr_gc_memlimit * 0.8 ) ) || ctr_gc_mode & 4 ) {
+					ctr_gc_internal_collect_auto();
+				}
+				break;
+			case CTR_OP_RETURN:
+				result = ctr_vm_stack[ctr_vm_top - 1];
+				ctr_vm_top = base;
+				return result;
+			case CTR_OP_END:
+				ctr_cwlk_uncaught_error();
+				ctr_vm_stack[ctr_vm_top++] = ctr_build_nil();
+				break;
+			case CTR_OP_HALT:
+				ctr_vm_top = base;
+				return NULL;
+		}
+		ip++;
+	}
+}
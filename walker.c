@@ -11,11 +11,13 @@
 /**
  * CTRWalkerReturn
  *
- * Returns from a block of code.
+ * Returns from a block of code. If tail is set, the last message
+ * of a returned message expression may become a tail call.
  */
-ctr_object* ctr_cwlk_return(ctr_tnode* node) {
+ctr_object* ctr_cwlk_return(ctr_tnode* node, int tail) {
 	char wasReturn = 0;
 	ctr_tlistitem* li;
+	ctr_tnode* returnNode;
 	ctr_object* e;
 	if (!node->nodes) {
 		printf("Invalid return expression.\n");
@@ -26,16 +28,97 @@ ctr_object* ctr_cwlk_return(ctr_tnode* node) {
 		printf("Invalid return expression 2.\n");
 		exit(1);
 	} 
-	e = ctr_cwlk_expr(li->node, &wasReturn);
+	returnNode = li->node;
+	while (tail && returnNode->type == CTR_AST_NODE_NESTED) returnNode = returnNode->nodes->node;
+	if (tail && returnNode->type == CTR_AST_NODE_EXPRMESSAGE) {
+		e = ctr_cwlk_message(returnNode, 1);
+	} else {
+		e = ctr_cwlk_expr(li->node, &wasReturn);
+	}
 	return e;
 }
 
+/**
+ * CTRWalkerQuickenLiteral
+ *
+ * Rewrites a literal node that always yields the same shared
+ * object (Nil, booleans, small integers) into a constant node.
+ */
+ctr_object* ctr_cwlk_quicken_literal(ctr_tnode* node, ctr_object* value) {
+	if (value->info.shared || value == CtrStdNil) {
+		node->constant = value;
+		node->type = CTR_AST_NODE_LTRCONST;
+	}
+	return value;
+}
+
+/**
+ * CTRWalkerSlot
+ *
+ * Returns the value of a reference node that has been resolved
+ * to a local slot. Only if the slot has not been filled yet, the
+ * generic lookup is used.
+ */
+ctr_object* ctr_cwlk_slot(ctr_tnode* node) {
+	ctr_object* result;
+	ctr_size index = ctr_slot_base[ctr_context_id] + node->slot - 1;
+	if (CtrStdFlow == NULL && index < ctr_slots_top && ctr_slots[index]) {
+		return ctr_slots[index]->value;
+	}
+	if (CtrStdFlow == NULL) {
+		ctr_callstack_push(node);
+	}
+	result = ctr_find_slot(node->symbol, node->slot);
+	if (CtrStdFlow == NULL) {
+		ctr_callstack_index--;
+	}
+	return result;
+}
+
+/**
+ * CTRWalkerSend
+ *
+ * Sends a message. A message node that has invoked a native
+ * function is rewritten into a native message node, next time
+ * the function is called directly as long as the receiver has the
+ * same method table owner and no method table has changed.
+ */
+ctr_object* ctr_cwlk_send(ctr_object* r, ctr_tnode* msgnode, ctr_argument* a, int tail) {
+	ctr_object* key;
+	ctr_object* methodObject;
+	ctr_object* result;
+	if (CtrStdFlow != NULL) return CtrStdNil;
+	key = ctr_inline_cache_key(r);
+	if (msgnode->type == CTR_AST_NODE_NATIVEMESSAGE
+		&& msgnode->quickKey == key
+		&& msgnode->quickEpoch == ctr_method_epoch
+		&& !(ctr_command_security_profile & (CTR_SECPRO_COUNTDOWN | CTR_SECPRO_EVAL))) {
+		result = msgnode->constant->value.fvalue(r, a);
+		if (r->info.chainMode == 1) return r;
+		return result;
+	}
+	result = ctr_send_message_dispatch(r, msgnode->symbol, a, msgnode->cache, tail);
+	/* messages to the parent (`) are never quickened */
+	if (key && msgnode->vlen > 0 && msgnode->value[0] != '`') {
+		methodObject = ctr_inline_cache_lookup(msgnode->cache, key);
+		if (methodObject && methodObject->info.type == CTR_OBJECT_TYPE_OTNATFUNC) {
+			msgnode->type = CTR_AST_NODE_NATIVEMESSAGE;
+			msgnode->constant = methodObject;
+			msgnode->quickKey = key;
+			msgnode->quickEpoch = ctr_method_epoch;
+		}
+	}
+	return result;
+}
+
 /**
  * CTRWalkerMessage
  *
- * Processes a message sending operation.
+ * Processes a message sending operation, tail is passed on to
+ * the last message (see ctr_cwlk_return).
  */
-ctr_object* ctr_cwlk_message(ctr_tnode* paramNode) {
+ctr_object* ctr_cwlk_message(ctr_tnode* paramNode, int tail) {
+	ctr_argument arguments[CTR_ARGUMENT_VECTOR_SIZE];
 	int sticky = 0;
 	char wasReturn = 0;
 	ctr_object* result;
@@ -43,21 +126,20 @@ ctr_object* ctr_cwlk_message(ctr_tnode* paramNode) {
 	ctr_tnode* receiverNode = eitem->node;
 	ctr_tnode* msgnode;
 	ctr_tlistitem* li = eitem;
-	char* message;
 	ctr_tlistitem* argumentList;
 	ctr_object* r;
 	ctr_object* recipientName = NULL;
 	switch (receiverNode->type) {
 		case CTR_AST_NODE_REFERENCE:
-			recipientName = ctr_build_string(receiverNode->value, receiverNode->vlen);
-			recipientName->info.sticky = 1;
+			recipientName = receiverNode->symbol;
 			if (CtrStdFlow == NULL) {
-				ctr_callstack[ctr_callstack_index++] = receiverNode;
+				ctr_callstack_push(receiverNode);
 			}
 			if (receiverNode->modifier == 1) {
-				r = ctr_find_in_my(recipientName);
+				r = ctr_find_in_my(recipientName, receiverNode);
 			} else {
-				r = ctr_find(recipientName);
+				r = ctr_find_slot(recipientName, receiverNode->slot);
+				if (receiverNode->slot > 0) receiverNode->type = CTR_AST_NODE_REFSLOT;
 			}
 			if (CtrStdFlow == NULL) {
 				ctr_callstack_index--;
@@ -66,20 +148,29 @@ ctr_object* ctr_cwlk_message(ctr_tnode* paramNode) {
 				exit(1);
 			}
 			break;
+		case CTR_AST_NODE_REFSLOT:
+			r = ctr_cwlk_slot(receiverNode);
+			if (!r) {
+				exit(1);
+			}
+			break;
+		case CTR_AST_NODE_LTRCONST:
+			r = receiverNode->constant;
+			break;
 		case CTR_AST_NODE_LTRNIL:
-			r = ctr_build_nil();
+			r = ctr_cwlk_quicken_literal(receiverNode, ctr_build_nil());
 			break;
 		case CTR_AST_NODE_LTRBOOLTRUE:
-			r = ctr_build_bool(1);
+			r = ctr_cwlk_quicken_literal(receiverNode, ctr_build_bool(1));
 			break;
 		case CTR_AST_NODE_LTRBOOLFALSE:
-			r = ctr_build_bool(0);
+			r = ctr_cwlk_quicken_literal(receiverNode, ctr_build_bool(0));
 			break;
 		case CTR_AST_NODE_LTRSTRING:
 			r = ctr_build_string(receiverNode->value, receiverNode->vlen);
 			break;
 		case CTR_AST_NODE_LTRNUM:
-			r = ctr_build_number_from_string(receiverNode->value, receiverNode->vlen);
+			r = ctr_cwlk_quicken_literal(receiverNode, ctr_build_number_from_float(receiverNode->nvalue));
 			break;
 		case CTR_AST_NODE_NESTED:
 			r = ctr_cwlk_expr(receiverNode, &wasReturn);
@@ -93,52 +184,37 @@ ctr_object* ctr_cwlk_message(ctr_tnode* paramNode) {
 	}
 	while(li->next) {
 		ctr_argument* a;
-		ctr_argument* aItem;
-		ctr_size l;
+		int argc;
+		int i;
 		li = li->next;
 		msgnode = li->node;
-		message = msgnode->value;
-		l = msgnode->vlen;
 		if (CtrStdFlow == NULL) {
-			ctr_callstack[ctr_callstack_index++] = msgnode;
+			ctr_callstack_push(msgnode);
 		}
+		argc = 0;
+		for(argumentList = msgnode->nodes; argumentList; argumentList = argumentList->next) argc++;
+		/* we always send at least one argument, note that if you want to modify the argumentList, be sure to take this into account */
+		/* there is always an extra empty argument at the end */
+		a = ctr_argument_vector(arguments, CTR_ARGUMENT_VECTOR_SIZE, argc + 1);
 		argumentList = msgnode->nodes;
-		a = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		aItem = a;
-		aItem->object = CtrStdNil;
-		if (argumentList) {
-			ctr_tnode* node;
-			node = argumentList->node;
-			while(1) {
-				ctr_object* o = ctr_cwlk_expr(node, &wasReturn);
-				aItem->object = o;
-				/* we always send at least one argument, note that if you want to modify the argumentList, be sure to take this into account */
-				/* there is always an extra empty argument at the end */
-				aItem->next = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-				aItem = aItem->next;
-				aItem->object = CtrStdNil;
-				if (!argumentList->next) break;
-				argumentList = argumentList->next;
-				node = argumentList->node;
-			}
+		for(i = 0; i < argc; i++) {
+			a[i].object = ctr_cwlk_expr(argumentList->node, &wasReturn);
+			argumentList = argumentList->next;
+		}
+		result = NULL;
+		if (msgnode->op) result = ctr_number_op_apply(msgnode->op, r, a->object);
+		if (result == NULL) {
+			sticky = r->info.sticky;
+			r->info.sticky = 1;
+			result = ctr_cwlk_send(r, msgnode, a, tail && li->next == NULL);
+			r->info.sticky = sticky;
 		}
-		sticky = r->info.sticky;
-		r->info.sticky = 1;
-		result = ctr_send_message(r, message, l, a);
-		r->info.sticky = sticky;
-		aItem = a;
 		if (CtrStdFlow == NULL) {
 			ctr_callstack_index --;
 		}
-		while(aItem->next) {
-			a = aItem;
-			aItem = aItem->next;
-			ctr_heap_free( a );
-		}
-		ctr_heap_free( aItem );
+		ctr_argument_vector_free(arguments, a);
 		r = result;
 	}
-	if (recipientName) recipientName->info.sticky = 0;
 	return result;
 }	
 
@@ -156,15 +232,15 @@ ctr_object* ctr_cwlk_assignment(ctr_tnode* node) {
 	ctr_object* x;
 	ctr_object* result;
 	if (CtrStdFlow == NULL) {
-		ctr_callstack[ctr_callstack_index++] = assignee;
+		ctr_callstack_push(assignee);
 	}
 	x = ctr_cwlk_expr(value, &wasReturn);
 	if (assignee->modifier == 1) {
-		result = ctr_assign_value_to_my(ctr_build_string(assignee->value, assignee->vlen), x);
+		result = ctr_assign_value_to_my(assignee->symbol, x, assignee);
 	} else if (assignee->modifier == 2) {
-		result = ctr_assign_value_to_local(ctr_build_string(assignee->value, assignee->vlen), x);
+		result = ctr_assign_value_to_slot(assignee->symbol, x, assignee->slot, 1);
 	} else {
-		result = ctr_assign_value(ctr_build_string(assignee->value, assignee->vlen), x);
+		result = ctr_assign_value_to_slot(assignee->symbol, x, assignee->slot, 0);
 	}
 	if (CtrStdFlow == NULL) {
 		ctr_callstack_index--;
@@ -173,89 +249,111 @@ ctr_object* ctr_cwlk_assignment(ctr_tnode* node) {
 }	
 
 /**
- * CTRWalkerExpression
+ * CTRWalkerUncaughtError
  *
- * Processes an expression.
+ * Reports an error that has not been caught by the end of the
+ * program, along with the call stack.
  */
-ctr_object* ctr_cwlk_expr(ctr_tnode* node, char* wasReturn) {
-	ctr_object* result;
-	uint8_t i;
+void ctr_cwlk_uncaught_error() {
+	int i;
 	int line;
 	char* currentProgram = "?";
 	ctr_tnode* stackNode;
 	ctr_source_map* mapItem;
+	if (CtrStdFlow && CtrStdFlow != CtrStdExit && ctr_cwlk_subprogram == 0) {
+		printf("Uncatched error has occurred.\n");
+		if (CtrStdFlow->info.type == CTR_OBJECT_TYPE_OTSTRING) {
+			fwrite(CtrStdFlow->value.svalue->value, sizeof(char), CtrStdFlow->value.svalue->vlen, stdout);
+			printf("\n");
+		}
+		i = ctr_callstack_index;
+		if (i > CTR_CALLSTACK_SIZE) i = CTR_CALLSTACK_SIZE;
+		for ( ; i > 0; i--) {
+			printf("#%d ", i);
+			stackNode = ctr_callstack[i-1];
+			fwrite(stackNode->value, sizeof(char), stackNode->vlen, stdout);
+			mapItem = ctr_source_map_head;
+			line = -1;
+			while(mapItem) {
+				if (line == -1 && mapItem->node == stackNode) {
+					line = mapItem->line;
+				}
+				if (line > -1 && mapItem->node->type == CTR_AST_NODE_PROGRAM) {
+					currentProgram = mapItem->node->value;
+					printf(" (%s: %d)", currentProgram, line+1);
+					break;
+				}
+				mapItem = mapItem->next;
+			}
+			printf("\n");
+		}
+	}
+}
+
+/**
+ * CTRWalkerExpression
+ *
+ * Processes an expression. Some nodes are rewritten after their
+ * first execution into specialized variants (quickening): literals
+ * of shared objects become constants and references to local slots
+ * skip the property lookup logic.
+ */
+ctr_object* ctr_cwlk_expr(ctr_tnode* node, char* wasReturn) {
+	ctr_object* result;
 	switch (node->type) {
 		case CTR_AST_NODE_LTRSTRING:
 			result = ctr_build_string(node->value, node->vlen);
 			break;
+		case CTR_AST_NODE_LTRCONST:
+			result = node->constant;
+			break;
 		case CTR_AST_NODE_LTRBOOLTRUE:
-			result = ctr_build_bool(1);
+			result = ctr_cwlk_quicken_literal(node, ctr_build_bool(1));
 			break;
 		case CTR_AST_NODE_LTRBOOLFALSE:
-			result = ctr_build_bool(0);
+			result = ctr_cwlk_quicken_literal(node, ctr_build_bool(0));
 			break;
 		case CTR_AST_NODE_LTRNIL:
-			result = ctr_build_nil();
+			result = ctr_cwlk_quicken_literal(node, ctr_build_nil());
 			break;
 		case CTR_AST_NODE_LTRNUM:
-			result = ctr_build_number_from_string(node->value, node->vlen);
+			result = ctr_cwlk_quicken_literal(node, ctr_build_number_from_float(node->nvalue));
 			break;
 		case CTR_AST_NODE_CODEBLOCK:
 			result = ctr_build_block(node);
 			break;
 		case CTR_AST_NODE_REFERENCE:
 			if (CtrStdFlow == NULL) {
-				ctr_callstack[ctr_callstack_index++] = node;
+				ctr_callstack_push(node);
 			}
 			if (node->modifier == 1) {
-				result = ctr_find_in_my(ctr_build_string(node->value, node->vlen));
+				result = ctr_find_in_my(node->symbol, node);
 			} else {
-				result = ctr_find(ctr_build_string(node->value, node->vlen));
+				result = ctr_find_slot(node->symbol, node->slot);
+				if (node->slot > 0) node->type = CTR_AST_NODE_REFSLOT;
 			}
 			if (CtrStdFlow == NULL) {
 				ctr_callstack_index--;
 			}
 			break;
+		case CTR_AST_NODE_REFSLOT:
+			result = ctr_cwlk_slot(node);
+			break;
 		case CTR_AST_NODE_EXPRMESSAGE:
-			result = ctr_cwlk_message(node);
+			result = ctr_cwlk_message(node, 0);
 			break;
 		case CTR_AST_NODE_EXPRASSIGNMENT:
 			result = ctr_cwlk_assignment(node);
 			break;
 		case CTR_AST_NODE_RETURNFROMBLOCK:
-			result = ctr_cwlk_return(node);
+			result = ctr_cwlk_return(node, 0);
 			*wasReturn = 1;
 			break;
 		case CTR_AST_NODE_NESTED:
 			result = ctr_cwlk_expr(node->nodes->node, wasReturn);
 			break;
 		case CTR_AST_NODE_ENDOFPROGRAM:
-			if (CtrStdFlow && CtrStdFlow != CtrStdExit && ctr_cwlk_subprogram == 0) {
-				printf("Uncatched error has occurred.\n");
-				if (CtrStdFlow->info.type == CTR_OBJECT_TYPE_OTSTRING) {
-					fwrite(CtrStdFlow->value.svalue->value, sizeof(char), CtrStdFlow->value.svalue->vlen, stdout);
-					printf("\n");
-				}
-				for ( i = ctr_callstack_index; i > 0; i--) {
-					printf("#%d ", i);
-					stackNode = ctr_callstack[i-1];
-					fwrite(stackNode->value, sizeof(char), stackNode->vlen, stdout);
-					mapItem = ctr_source_map_head;
-					line = -1;
-					while(mapItem) {
-						if (line == -1 && mapItem->node == stackNode) {
-							line = mapItem->line;
-						}
-						if (line > -1 && mapItem->node->type == CTR_AST_NODE_PROGRAM) {
-							currentProgram = mapItem->node->value;
-							printf(" (%s: %d)", currentProgram, line+1);
-							break;
-						}
-						mapItem = mapItem->next;
-					}
-					printf("\n");
-				}
-			}
+			ctr_cwlk_uncaught_error();
 			result = ctr_build_nil();
 			break;
 		default:
@@ -272,6 +370,16 @@ ctr_object* ctr_cwlk_expr(ctr_tnode* node, char* wasReturn) {
  * Processes the execution of a block of code.
  */
 ctr_object* ctr_cwlk_run(ctr_tnode* program) {
+	return ctr_cwlk_run_body(program, 0);
+}
+
+/**
+ * CTRWalkerRunBody
+ *
+ * Processes the execution of a block of code. Only ctr_block_run
+ * sets tail, a returned message may then become a tail call.
+ */
+ctr_object* ctr_cwlk_run_body(ctr_tnode* program, int tail) {
 	ctr_object* result = NULL;
 	char wasReturn = 0;
 	ctr_tlistitem* li;
@@ -283,13 +391,18 @@ ctr_object* ctr_cwlk_run(ctr_tnode* program) {
 			exit(1);
 		}
 		wasReturn = 0;
-		result = ctr_cwlk_expr(node, &wasReturn);
+		if (tail && node->type == CTR_AST_NODE_RETURNFROMBLOCK) {
+			result = ctr_cwlk_return(node, 1);
+			wasReturn = 1;
+		} else {
+			result = ctr_cwlk_expr(node, &wasReturn);
+		}
 		if ( wasReturn ) {
 			break;
 		}
 		/* Perform garbage collection cycle */
 		if ( ( ( ctr_gc_mode & 1 ) && ctr_gc_alloc > ( ctr_gc_memlimit * 0.8 ) ) || ctr_gc_mode & 4 ) {
-			ctr_gc_internal_collect();
+			ctr_gc_internal_collect_auto();
 		}
 		if (!li->next) break;
 		li = li->next;
@@ -6,6 +6,7 @@
 #include <math.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <sys/resource.h>
 #include <time.h>
 
 #ifdef forLinux
@@ -101,41 +102,383 @@ int ctr_internal_object_is_equal(ctr_object* object1, ctr_object* object2) {
  * lookup.
  */
 uint64_t ctr_internal_index_hash(ctr_object* key) {
-	ctr_object* stringKey = ctr_internal_cast2string(key);
+	ctr_object* stringKey;
+	ctr_string* s;
+	if (key->info.type == CTR_OBJECT_TYPE_OTSTRING) {
+		s = key->value.svalue;
+		if (!s->hashed) {
+			s->hash = siphash24(s->value, s->vlen, CtrHashKey);
+			s->hashed = 1;
+		}
+		return s->hash;
+	}
+	stringKey = ctr_internal_cast2string(key);
 	return siphash24(stringKey->value.svalue->value, stringKey->value.svalue->vlen, CtrHashKey);
 }
 
 /**
  * @internal
  *
- * InternalObjectFindProperty
+ * InternalSymbolTableGrow
  *
- * Finds property in object.
+ * Doubles the size of the symbol table and re-inserts all symbols.
  */
-ctr_object* ctr_internal_object_find_property(ctr_object* owner, ctr_object* key, int is_method) {
-	ctr_mapitem* head;
-	uint64_t hashKey = ctr_internal_index_hash(key);
+void ctr_internal_symbols_grow() {
+	ctr_size i;
+	ctr_size j;
+	ctr_size oldSize = ctr_symbols_size;
+	ctr_object** oldSymbols = ctr_symbols;
+	ctr_symbols_size = oldSize * 2;
+	ctr_symbols = ctr_heap_allocate( ctr_symbols_size * sizeof( ctr_object* ) );
+	for(i = 0; i < oldSize; i++) {
+		if (oldSymbols[i] == NULL) continue;
+		j = oldSymbols[i]->value.svalue->hash & (ctr_symbols_size - 1);
+		while(ctr_symbols[j]) j = (j + 1) & (ctr_symbols_size - 1);
+		ctr_symbols[j] = oldSymbols[i];
+	}
+	ctr_heap_free( oldSymbols );
+}
 
-	if (is_method) {
-		if (owner->methods->size == 0) {
-			return NULL;
+/**
+ * @internal
+ *
+ * InternalSymbol
+ *
+ * Returns the symbol (interned string) for the specified name.
+ * Symbols are sticky strings with a precomputed hash, there is
+ * only one symbol per name so they can be compared by pointer.
+ * If create is 0 and the name has not been interned yet, this
+ * function returns NULL.
+ */
+ctr_object* ctr_internal_symbol(char* name, ctr_size vlen, int create) {
+	ctr_object* symbol;
+	uint64_t hash = siphash24(name, vlen, CtrHashKey);
+	ctr_size i = hash & (ctr_symbols_size - 1);
+	while((symbol = ctr_symbols[i])) {
+		if (symbol->value.svalue->hash == hash
+			&& symbol->value.svalue->vlen == vlen
+			&& memcmp(symbol->value.svalue->value, name, vlen) == 0) {
+			return symbol;
 		}
-		head = owner->methods->head;
-	} else {
-		if (owner->properties->size == 0) {
-			return NULL;
+		i = (i + 1) & (ctr_symbols_size - 1);
+	}
+	if (!create) return NULL;
+	symbol = ctr_build_string(name, vlen);
+	symbol->info.sticky = 1;
+	symbol->info.interned = 1;
+	symbol->value.svalue->hash = hash;
+	symbol->value.svalue->hashed = 1;
+	ctr_symbols[i] = symbol;
+	ctr_symbols_count++;
+	if (ctr_symbols_count * 2 > ctr_symbols_size) {
+		ctr_internal_symbols_grow();
+	}
+	return symbol;
+}
+
+/**
+ * @internal
+ *
+ * InternalMapIndexInsert
+ *
+ * Inserts an item into the open addressing index of a map.
+ * The index uses Robin Hood hashing: an item that is further
+ * away from its ideal slot takes the place of an item that is
+ * closer to its own, this keeps probe sequences short.
+ * If the index already contains an item with the same key, the
+ * new item replaces it (the newest item always wins, the older
+ * one remains in the list).
+ */
+void ctr_internal_map_index_insert(ctr_map* map, ctr_mapitem* item) {
+	ctr_mapitem* current;
+	ctr_mapitem* original = item;
+	ctr_size mask = map->capacity - 1;
+	ctr_size pos = item->hashKey & mask;
+	ctr_size dist = 0;
+	ctr_size currentDist;
+	while((current = map->index[pos])) {
+		if (item == original && current->hashKey == item->hashKey
+			&& (current->key == item->key || ctr_internal_object_is_equal(current->key, item->key))) {
+			map->index[pos] = item;
+			return;
+		}
+		currentDist = (pos - (current->hashKey & mask)) & mask;
+		if (currentDist < dist) {
+			map->index[pos] = item;
+			item = current;
+			dist = currentDist;
+		}
+		pos = (pos + 1) & mask;
+		dist++;
+	}
+	map->index[pos] = item;
+}
+
+/**
+ * @internal
+ *
+ * InternalMapIndexRemove
+ *
+ * Removes an item from the index of a map, the items behind it
+ * are shifted back so no tombstones are required.
+ */
+void ctr_internal_map_index_remove(ctr_map* map, ctr_mapitem* item) {
+	ctr_mapitem* next;
+	ctr_size mask = map->capacity - 1;
+	ctr_size pos = item->hashKey & mask;
+	while(map->index[pos] != item) {
+		pos = (pos + 1) & mask;
+	}
+	while(1) {
+		next = map->index[(pos + 1) & mask];
+		if (next == NULL || (next->hashKey & mask) == ((pos + 1) & mask)) break;
+		map->index[pos] = next;
+		pos = (pos + 1) & mask;
+	}
+	map->index[pos] = NULL;
+}
+
+/**
+ * @internal
+ *
+ * InternalMapIndexBuild
+ *
+ * (Re)builds the index of a map with the specified capacity
+ * (must be a power of 2). Items are inserted from old to new
+ * so newer items shadow older items having the same key.
+ */
+void ctr_internal_map_index_build(ctr_map* map, int capacity) {
+	ctr_mapitem* item;
+	if (map->index) {
+		ctr_heap_free( map->index );
+	}
+	map->capacity = capacity;
+	map->index = ctr_heap_allocate( capacity * sizeof( ctr_mapitem* ) );
+	item = map->head;
+	while(item && item->next) {
+		item = item->next;
+	}
+	while(item) {
+		ctr_internal_map_index_insert(map, item);
+		item = item->prev;
+	}
+}
+
+/**
+ * @internal
+ *
+ * InternalMapFind
+ *
+ * Finds the item having the specified key in a map.
+ * Small maps are simply scanned, larger maps use the index.
+ */
+ctr_mapitem* ctr_internal_map_find(ctr_map* map, ctr_object* key) {
+	ctr_mapitem* item;
+	ctr_size mask;
+	ctr_size pos;
+	ctr_size dist;
+	uint64_t hashKey;
+	if (map->size == 0) {
+		return NULL;
+	}
+	hashKey = ctr_internal_index_hash(key);
+	if (map->index == NULL) {
+		item = map->head;
+		while(item) {
+			if (item->key == key || ((hashKey == item->hashKey) && ctr_internal_object_is_equal(item->key, key))) {
+				return item;
+			}
+			item = item->next;
 		}
-		head = owner->properties->head;
+		return NULL;
 	}
-	while(head) {
-		if ((hashKey == head->hashKey) && ctr_internal_object_is_equal(head->key, key)) {
-			return head->value;
+	mask = map->capacity - 1;
+	pos = hashKey & mask;
+	dist = 0;
+	while((item = map->index[pos])) {
+		if ((hashKey == item->hashKey) && (item->key == key || ctr_internal_object_is_equal(item->key, key))) {
+			return item;
+		}
+		/* an item closer to its ideal slot means the key is not here */
+		if (((pos - (item->hashKey & mask)) & mask) < dist) {
+			return NULL;
 		}
-		head = head->next;
+		pos = (pos + 1) & mask;
+		dist++;
 	}
 	return NULL;
 }
 
+/**
+ * @internal
+ *
+ * InternalMapMoveToFront
+ *
+ * Moves an item to the front of the list of a map.
+ */
+void ctr_internal_map_move_to_front(ctr_map* map, ctr_mapitem* item) {
+	if (item->prev) {
+		item->prev->next = item->next;
+		if (item->next) {
+			item->next->prev = item->prev;
+		}
+		item->prev = NULL;
+		item->next = map->head;
+		map->head->prev = item;
+		map->head = item;
+	}
+}
+
+/**
+ * @internal
+ *
+ * InternalShapeTransition
+ *
+ * Returns the shape that results from adding a property with
+ * the specified (interned) key to an object of the specified shape.
+ */
+ctr_shape* ctr_internal_shape_transition(ctr_shape* shape, ctr_object* key) {
+	ctr_shape* child = shape->child;
+	while(child) {
+		if (child->key == key) return child;
+		child = child->sibling;
+	}
+	child = ctr_heap_allocate_tracked(sizeof(ctr_shape));
+	child->key = key;
+	child->size = shape->size + 1;
+	child->parent = shape;
+	child->sibling = shape->child;
+	shape->child = child;
+	return child;
+}
+
+/**
+ * @internal
+ *
+ * InternalShapeFind
+ *
+ * Returns the position of the newest property having the
+ * specified key in a shape or -1 if there is no such property.
+ */
+int ctr_internal_shape_find(ctr_shape* shape, ctr_object* key) {
+	while(shape->parent) {
+		if (shape->key == key) return shape->size - 1;
+		shape = shape->parent;
+	}
+	return -1;
+}
+
+/**
+ * @internal
+ *
+ * InternalMapShapeAdd
+ *
+ * Moves a map in shape mode to the shape having the specified
+ * (interned) key added and returns the item for the new property,
+ * the last one of the item array. The array grows by doubling, if
+ * it moves the items are linked again.
+ */
+ctr_mapitem* ctr_internal_map_shape_add(ctr_map* map, ctr_object* key) {
+	ctr_mapitem* item;
+	int i;
+	map->shape = ctr_internal_shape_transition(map->shape, key);
+	if (map->shape->size > map->itemsCapacity) {
+		if (map->items) {
+			map->itemsCapacity = map->itemsCapacity * 2;
+			map->items = ctr_heap_reallocate(map->items, map->itemsCapacity * sizeof(ctr_mapitem));
+			for(i = 0; i < map->size; i++) {
+				map->items[i].next = (i > 0) ? map->items + i - 1 : NULL;
+				map->items[i].prev = (i + 1 < map->size) ? map->items + i + 1 : NULL;
+			}
+			map->head = map->items + map->size - 1;
+			if (map->index) ctr_internal_map_index_build(map, map->capacity);
+		} else {
+			map->itemsCapacity = 4;
+			map->items = ctr_heap_allocate(map->itemsCapacity * sizeof(ctr_mapitem));
+		}
+	}
+	item = map->items + map->shape->size - 1;
+	item->prev = NULL;
+	item->next = map->head;
+	if (map->head) {
+		map->head->prev = item;
+	}
+	map->head = item;
+	return item;
+}
+
+/**
+ * @internal
+ *
+ * InternalMapDictionary
+ *
+ * Switches a property map to dictionary mode (no shape), every
+ * item in the item array gets an allocation of its own.
+ */
+void ctr_internal_map_dictionary(ctr_map* map) {
+	ctr_mapitem* items = map->items;
+	ctr_mapitem* item;
+	int i;
+	map->shape = NULL;
+	if (items == NULL) return;
+	map->head = NULL;
+	for(i = 0; i < map->size; i++) {
+		item = ctr_heap_allocate(sizeof(ctr_mapitem));
+		*item = items[i];
+		item->prev = NULL;
+		item->next = map->head;
+		if (map->head) {
+			map->head->prev = item;
+		}
+		map->head = item;
+	}
+	ctr_heap_free( items );
+	map->items = NULL;
+	map->itemsCapacity = 0;
+	if (map->index) ctr_internal_map_index_build(map, map->capacity);
+}
+
+/**
+ * @internal
+ *
+ * InternalShapeLookup
+ *
+ * Returns the item of the property with the specified key using
+ * the shape of the map, the position found is remembered by the
+ * node. Returns NULL if the map has no shape or no such property.
+ */
+ctr_mapitem* ctr_internal_shape_lookup(ctr_map* map, ctr_object* key, ctr_tnode* site) {
+	int slot;
+	if (!map->shape) return NULL;
+	if (map->shape == site->shape) return map->items + site->shapeSlot;
+	if (!key->info.interned) return NULL;
+	slot = ctr_internal_shape_find(map->shape, key);
+	if (slot < 0) return NULL;
+	site->shape = map->shape;
+	site->shapeSlot = slot;
+	return map->items + slot;
+}
+
+/**
+ * @internal
+ *
+ * InternalObjectFindProperty
+ *
+ * Finds property in object.
+ */
+ctr_object* ctr_internal_object_find_property(ctr_object* owner, ctr_object* key, int is_method) {
+	ctr_mapitem* item;
+	if (is_method) {
+		item = ctr_internal_map_find(owner->methods, key);
+	} else {
+		item = ctr_internal_map_find(owner->properties, key);
+	}
+	if (item == NULL) {
+		return NULL;
+	}
+	return item->value;
+}
+
 
 /**
  * @internal
@@ -145,57 +488,68 @@ ctr_object* ctr_internal_object_find_property(ctr_object* owner, ctr_object* key
  * Deletes the specified property from the object.
  */
 void ctr_internal_object_delete_property(ctr_object* owner, ctr_object* key, int is_method) {
-	uint64_t hashKey = ctr_internal_index_hash(key);
+	ctr_map* map;
 	ctr_mapitem* head;
+	ctr_mapitem* shadowed;
 	if (is_method) {
-		if (owner->methods->size == 0) {
-			return;
-		}
-		head = owner->methods->head;
+		map = owner->methods;
+		ctr_method_epoch++;
+		if (owner == CtrStdNumber) ctr_number_op_invalidate(key);
 	} else {
-		if (owner->properties->size == 0) {
-			return;
-		}
-		head = owner->properties->head;
-	}
-	while(head) {
-		if ((hashKey == head->hashKey) && ctr_internal_object_is_equal(head->key, key)) {
-			if (head->next && head->prev) {
-				head->next->prev = head->prev;
-				head->prev->next = head->next;
-			} else {
-				if (head->next) {
-					head->next->prev = NULL;
-				}
-				if (head->prev) {
-					head->prev->next = NULL;
-				}
-			}
-			if (is_method) {
-				if (owner->methods->head == head) {
-					if (head->next) {
-						owner->methods->head = head->next;
-					} else {
-						owner->methods->head = NULL;
-					}
-				}
-				owner->methods->size --;
-			} else {
-				if (owner->properties->head == head) {
-					if (head->next) {
-						owner->properties->head = head->next;
-					} else {
-						owner->properties->head = NULL;
-					}
-				}
-				owner->properties->size --;
+		map = owner->properties;
+	}
+	head = ctr_internal_map_find(map, key);
+	if (head && map->shape) {
+		ctr_internal_map_dictionary(map);
+		head = ctr_internal_map_find(map, key);
+	}
+	if (head == NULL) {
+		return;
+	}
+	if (head->next) {
+		head->next->prev = head->prev;
+	}
+	if (head->prev) {
+		head->prev->next = head->next;
+	} else {
+		map->head = head->next;
+	}
+	map->size --;
+	if (map->index) {
+		ctr_internal_map_index_remove(map, head);
+		/* an older item having the same key becomes visible again */
+		shadowed = head->next;
+		while(shadowed) {
+			if ((shadowed->hashKey == head->hashKey) && ctr_internal_object_is_equal(shadowed->key, head->key)) {
+				ctr_internal_map_index_insert(map, shadowed);
+				break;
 			}
-			ctr_heap_free( head );
-			return;
+			shadowed = shadowed->next;
+		}
+	}
+	ctr_heap_free( head );
+}
+
+/**
+ * @internal
+ *
+ * InternalObjectMap
+ *
+ * Returns the property or method map of an object to add an item to.
+ * Objects share an empty map until they get their first item.
+ */
+ctr_map* ctr_internal_object_map(ctr_object* owner, int is_method) {
+	if (is_method) {
+		if (owner->methods == &ctr_map_no_methods) {
+			owner->methods = ctr_heap_allocate(sizeof(ctr_map));
 		}
-		head = head->next;
+		return owner->methods;
+	}
+	if (owner->properties == &ctr_map_no_properties) {
+		owner->properties = ctr_heap_allocate(sizeof(ctr_map));
+		owner->properties->shape = &ctr_shape_root;
 	}
-	return;
+	return owner->properties;
 }
 
 /**
@@ -206,33 +560,44 @@ void ctr_internal_object_delete_property(ctr_object* owner, ctr_object* key, int
  * Adds a property to an object.
  */
 void ctr_internal_object_add_property(ctr_object* owner, ctr_object* key, ctr_object* value, int m) {
-	ctr_mapitem* new_item = ctr_heap_allocate(sizeof(ctr_mapitem));
-	ctr_mapitem* current_head = NULL;
-	new_item->key = key;
-	new_item->hashKey = ctr_internal_index_hash(key);
-	new_item->value = value;
-	new_item->next = NULL;
-	new_item->prev = NULL;
+	ctr_mapitem* new_item;
+	ctr_map* map;
+	if (m && key->info.type == CTR_OBJECT_TYPE_OTSTRING && !key->info.interned) {
+		key = ctr_internal_symbol(key->value.svalue->value, key->value.svalue->vlen, 1);
+	}
 	if (m) {
-		if (owner->methods->size == 0) {
-			owner->methods->head = new_item;
-		} else {
-			current_head = owner->methods->head;
-			current_head->prev = new_item;
-			new_item->next = current_head;
-			owner->methods->head = new_item;
-		}
-		owner->methods->size ++;
+		ctr_method_epoch++;
+		if (owner == CtrStdNumber) ctr_number_op_invalidate(key);
+	}
+	map = ctr_internal_object_map(owner, m);
+	if (map->shape && (!key->info.interned || map->shape->size == CTR_SHAPE_MAX_SIZE)) {
+		ctr_internal_map_dictionary(map);
+	}
+	if (map->shape) {
+		new_item = ctr_internal_map_shape_add(map, key);
 	} else {
-		if (owner->properties->size == 0) {
-			owner->properties->head = new_item;
+		new_item = ctr_heap_allocate(sizeof(ctr_mapitem));
+		new_item->prev = NULL;
+		new_item->next = map->head;
+		if (map->head) {
+			map->head->prev = new_item;
+		}
+		map->head = new_item;
+	}
+	new_item->key = key;
+	new_item->hashKey = ctr_internal_index_hash(key);
+	new_item->value = ctr_internal_unshare(value);
+	ctr_gc_write_barrier(owner, key);
+	ctr_gc_write_barrier(owner, new_item->value);
+	map->size ++;
+	if (map->index) {
+		if (map->size * 4 > map->capacity * 3) {
+			ctr_internal_map_index_build(map, map->capacity * 2);
 		} else {
-			current_head = owner->properties->head;
-			current_head->prev = new_item;
-			new_item->next = current_head;
-			owner->properties->head = new_item;
+			ctr_internal_map_index_insert(map, new_item);
 		}
-		owner->properties->size ++;
+	} else if (map->size > CTR_MAP_INDEX_THRESHOLD) {
+		ctr_internal_map_index_build(map, CTR_MAP_INDEX_THRESHOLD * 4);
 	}
 }
 
@@ -241,11 +606,29 @@ void ctr_internal_object_add_property(ctr_object* owner, ctr_object* key, ctr_ob
  *
  * InternalObjectSetProperty
  *
- * Sets a property on an object.
+ * Sets a property on an object. An existing entry is updated
+ * and moved to the front (like a newly added entry), unless the
+ * map is in shape mode.
  */
 void ctr_internal_object_set_property(ctr_object* owner, ctr_object* key, ctr_object* value, int is_method) {
-	ctr_internal_object_delete_property(owner, key, is_method);
-	ctr_internal_object_add_property(owner, key, value, is_method);
+	ctr_map* map;
+	ctr_mapitem* item;
+	if (is_method) {
+		ctr_internal_object_delete_property(owner, key, is_method);
+		ctr_internal_object_add_property(owner, key, value, is_method);
+		return;
+	}
+	map = owner->properties;
+	item = ctr_internal_map_find(map, key);
+	if (item == NULL) {
+		ctr_internal_object_add_property(owner, key, value, is_method);
+		return;
+	}
+	item->key = key;
+	item->value = ctr_internal_unshare(value);
+	ctr_gc_write_barrier(owner, key);
+	ctr_gc_write_barrier(owner, item->value);
+	if (!map->shape) ctr_internal_map_move_to_front(map, item);
 }
 
 /**
@@ -286,15 +669,11 @@ char* ctr_internal_memmem(char* haystack, long hlen, char* needle, long nlen, in
 ctr_object* ctr_internal_create_object(int type) {
 	ctr_object* o;
 	o = ctr_heap_allocate(sizeof(ctr_object));
-	o->properties = ctr_heap_allocate(sizeof(ctr_map));
-	o->methods = ctr_heap_allocate(sizeof(ctr_map));
-	o->properties->size = 0;
-	o->methods->size = 0;
-	o->properties->head = NULL;
-	o->methods->head = NULL;
+	o->properties = &ctr_map_no_properties;
+	o->methods = &ctr_map_no_methods;
 	o->info.type = type;
 	o->info.sticky = 0;
-	o->info.mark = 0;
+	o->info.mark = ctr_gc_marking; /* objects created while marking are black */
 	o->info.remote = 0;
 	if (type==CTR_OBJECT_TYPE_OTBOOL) o->value.bvalue = 0;
 	if (type==CTR_OBJECT_TYPE_OTNUMBER) o->value.nvalue = 0;
@@ -335,10 +714,10 @@ void ctr_internal_create_func(ctr_object* o, ctr_object* key, ctr_object* (*func
  */
 ctr_object* ctr_internal_cast2number(ctr_object* o) {
 	if ( o->info.type == CTR_OBJECT_TYPE_OTNUMBER ) return o;
-	ctr_argument* a = ctr_heap_allocate( sizeof( ctr_argument ) );
-	a->object = CtrStdNil;
-	ctr_object* numObject = ctr_send_message( o, "toNumber", 8, a );
-	ctr_heap_free(a);
+	ctr_argument a;
+	a.object = CtrStdNil;
+	a.next = NULL;
+	ctr_object* numObject = ctr_send_message( o, "toNumber", 8, &a );
 	if ( numObject->info.type != CTR_OBJECT_TYPE_OTNUMBER ) {
 		CtrStdFlow = ctr_build_string_from_cstring( "toNumber must return a number." );
 		return ctr_build_number_from_float((ctr_number)0);
@@ -355,10 +734,10 @@ ctr_object* ctr_internal_cast2number(ctr_object* o) {
  */
 ctr_object* ctr_internal_cast2string( ctr_object* o ) {
 	if ( o->info.type == CTR_OBJECT_TYPE_OTSTRING ) return o;
-	ctr_argument* a = ctr_heap_allocate( sizeof( ctr_argument ) );
-	a->object = CtrStdNil;
-	ctr_object* stringObject = ctr_send_message( o, "toString", 8, a );
-	ctr_heap_free(a);
+	ctr_argument a;
+	a.object = CtrStdNil;
+	a.next = NULL;
+	ctr_object* stringObject = ctr_send_message( o, "toString", 8, &a );
 	if ( stringObject->info.type != CTR_OBJECT_TYPE_OTSTRING ) {
 		CtrStdFlow = ctr_build_string_from_cstring( "toString must return a string." );
 		return ctr_build_string_from_cstring( "?" );
@@ -375,10 +754,10 @@ ctr_object* ctr_internal_cast2string( ctr_object* o ) {
  */
 ctr_object* ctr_internal_cast2bool( ctr_object* o ) {
 	if (o->info.type == CTR_OBJECT_TYPE_OTBOOL) return o;
-	ctr_argument* a = ctr_heap_allocate( sizeof( ctr_argument ) );
-	a->object = CtrStdNil;
-	ctr_object* boolObject = ctr_send_message( o, "toBoolean", 9, a );
-	ctr_heap_free(a);
+	ctr_argument a;
+	a.object = CtrStdNil;
+	a.next = NULL;
+	ctr_object* boolObject = ctr_send_message( o, "toBoolean", 9, &a );
 	if ( boolObject->info.type != CTR_OBJECT_TYPE_OTBOOL ) {
 		CtrStdFlow = ctr_build_string_from_cstring( "toBoolean must return a boolean." );
 		return ctr_build_bool(0);
@@ -386,6 +765,38 @@ ctr_object* ctr_internal_cast2bool( ctr_object* o ) {
 	return boolObject;
 }
 
+/**
+ * @internal
+ *
+ * InternalStackSize
+ *
+ * Returns the size of the C stack (its soft limit), or a default
+ * if there is no limit.
+ */
+size_t ctr_internal_stack_size() {
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_STACK, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+		return CTR_STACK_DEFAULT_SIZE;
+	}
+	return (size_t) limit.rlim_cur;
+}
+
+/**
+ * @internal
+ *
+ * InternalCreateContext
+ *
+ * Creates a (sticky) context object. Locals come and go and slots
+ * point to their items, so a context has a property map without
+ * a shape.
+ */
+ctr_object* ctr_internal_create_context() {
+	ctr_object* context = ctr_internal_create_object(CTR_OBJECT_TYPE_OTOBJECT);
+	context->info.sticky = 1;
+	context->properties = ctr_heap_allocate(sizeof(ctr_map));
+	return context;
+}
+
 /**
  * @internal
  *
@@ -395,13 +806,51 @@ ctr_object* ctr_internal_cast2bool( ctr_object* o ) {
  */
 void ctr_open_context() {
 	ctr_object* context;
-	if (ctr_context_id >= 299) {
+	char here;
+	size_t used;
+	int i;
+	used = (&here < ctr_stack_base) ? (size_t) (ctr_stack_base - &here) : (size_t) (&here - ctr_stack_base);
+	if ((ctr_context_max_depth > 0 && ctr_context_id >= ctr_context_max_depth) || used + CTR_STACK_RESERVE > ctr_stack_size || ctr_gc_alloc > ctr_gc_memlimit * 0.95) {
 		CtrStdFlow = ctr_build_string_from_cstring( "Too many nested calls." );
 		CtrStdFlow->info.sticky = 1;
 	}
-	context = ctr_internal_create_object(CTR_OBJECT_TYPE_OTOBJECT);
-	context->info.sticky = 1;
+	if (ctr_context_id + 1 >= ctr_contexts_size) {
+		ctr_contexts_size *= 2;
+		ctr_contexts = ctr_heap_reallocate_tracked( ctr_contexts_tracking_id, ctr_contexts_size * sizeof( ctr_object* ) );
+		ctr_slot_base = ctr_heap_reallocate_tracked( ctr_slot_base_tracking_id, ctr_contexts_size * sizeof( ctr_size ) );
+		ctr_context_receivers = ctr_heap_reallocate_tracked( ctr_context_receivers_tracking_id, ctr_contexts_size * sizeof( ctr_object* ) );
+		for(i = ctr_context_id + 1; i < ctr_contexts_size; i++) {
+			ctr_contexts[i] = NULL;
+		}
+	}
+	context = ctr_contexts[ctr_context_id + 1];
+	if (context == NULL) {
+		context = ctr_internal_create_context();
+	}
 	ctr_contexts[++ctr_context_id] = context;
+	ctr_slot_base[ctr_context_id] = ctr_slots_top;
+	ctr_context_receivers[ctr_context_id] = NULL;
+}
+
+/**
+ * @internal
+ *
+ * ContextReserveSlots
+ *
+ * Reserves the specified number of (empty) local variable slots
+ * for the current context.
+ */
+void ctr_context_reserve_slots(int n) {
+	ctr_size i;
+	ctr_size required = ctr_slots_top + n;
+	if (required > ctr_slots_size) {
+		while(ctr_slots_size < required) ctr_slots_size *= 2;
+		ctr_slots = ctr_heap_reallocate_tracked( ctr_slots_tracking_id, ctr_slots_size * sizeof( ctr_mapitem* ) );
+	}
+	for(i = ctr_slots_top; i < required; i++) {
+		ctr_slots[i] = NULL;
+	}
+	ctr_slots_top = required;
 }
 
 /**
@@ -412,11 +861,50 @@ void ctr_open_context() {
  * Closes a context.
  */
 void ctr_close_context() {
-	ctr_contexts[ctr_context_id]->info.sticky = 0;
-	if (ctr_context_id == 0) return;
+	ctr_object* context = ctr_contexts[ctr_context_id];
+	ctr_mapitem* item;
+	ctr_mapitem* next;
+	if (ctr_context_id == 0) {
+		context->info.sticky = 0;
+		return;
+	}
+	/* empty the context so it can be reused by the next call */
+	item = context->properties->head;
+	while(item) {
+		next = item->next;
+		ctr_heap_free( item );
+		item = next;
+	}
+	if (context->properties->index) {
+		ctr_heap_free( context->properties->index );
+		context->properties->index = NULL;
+		context->properties->capacity = 0;
+	}
+	context->properties->head = NULL;
+	context->properties->size = 0;
+	ctr_slots_top = ctr_slot_base[ctr_context_id];
 	ctr_context_id--;
 }
 
+/**
+ * @internal
+ *
+ * CTRFindSlot
+ *
+ * Returns the value of a local variable using its slot in the
+ * current context. If the variable has not been declared yet
+ * (or there is no slot) the variable is looked up by name.
+ */
+ctr_object* ctr_find_slot(ctr_object* key, int slot) {
+	ctr_size index;
+	if (CtrStdFlow) return CtrStdNil;
+	index = ctr_slot_base[ctr_context_id] + slot - 1;
+	if (slot > 0 && index < ctr_slots_top && ctr_slots[index]) {
+		return ctr_slots[index]->value;
+	}
+	return ctr_find(key);
+}
+
 /**
  * @internal
  *
@@ -458,17 +946,63 @@ ctr_object* ctr_find(ctr_object* key) {
 	return foundObject;
 }
 
+/**
+ * @internal
+ *
+ * CTRFindMe
+ *
+ * Returns the receiver of the method that is running, this is
+ * the receiver of the nearest context that has one. Outside of a
+ * method me is looked up like any other variable.
+ */
+ctr_object* ctr_find_me() {
+	int i;
+	for(i = ctr_context_id; i > 0; i--) {
+		if (ctr_context_receivers[i]) return ctr_context_receivers[i];
+	}
+	return ctr_find(ctr_symbol_me);
+}
+
+/**
+ * @internal
+ *
+ * CTRUnshareMe
+ *
+ * Replaces a shared receiver (a small integer, True or False) of the
+ * method being run by a private copy, so the method can store
+ * properties without changing the shared object.
+ */
+ctr_object* ctr_unshare_me() {
+	int i;
+	ctr_object* me;
+	for(i = ctr_context_id; i > 0; i--) {
+		if (ctr_context_receivers[i]) break;
+	}
+	me = ctr_context_receivers[i];
+	if (!me || !me->info.shared) return ctr_find_me();
+	me = ctr_internal_unshare(me);
+	ctr_context_receivers[i] = me;
+	ctr_internal_object_set_property(ctr_contexts[i], ctr_symbol_me, me, 0);
+	ctr_internal_object_set_property(ctr_contexts[i], ctr_symbol_me_icon, me, 0);
+	return me;
+}
+
 /**
  * @internal
  *
  * CTRFindInMy
  *
- * Tries to locate a property of an object.
+ * Tries to locate a property of an object. If a site (the
+ * reference node) is specified, the shape of the object is
+ * used to find the property.
  */
-ctr_object* ctr_find_in_my(ctr_object* key) {
-	ctr_object* context = ctr_find(ctr_build_string_from_cstring( ctr_clex_keyword_me ) );
-	ctr_object* foundObject = ctr_internal_object_find_property(context, key, 0);
+ctr_object* ctr_find_in_my(ctr_object* key, ctr_tnode* site) {
+	ctr_object* context = ctr_find_me();
+	ctr_object* foundObject;
+	ctr_mapitem* item;
 	if (CtrStdFlow) return CtrStdNil;
+	item = site ? ctr_internal_shape_lookup(context->properties, key, site) : NULL;
+	foundObject = item ? item->value : ctr_internal_object_find_property(context, key, 0);
 	if (foundObject == NULL) {
 		char* key_name;
 		char* message;
@@ -539,15 +1073,51 @@ void ctr_set(ctr_object* key, ctr_object* object) {
  */
 void ctr_initialize_world() {
 	int i;
+	ctr_map_no_properties.shape = &ctr_shape_root;
 	srand((unsigned)time(NULL));
 	for(i=0; i<16; i++) {
 		CtrHashKey[i] = (int) arc4random_uniform(256);
 	}
+	ctr_symbols_size = 1024;
+	ctr_symbols_count = 0;
+	ctr_symbols = ctr_heap_allocate( ctr_symbols_size * sizeof( ctr_object* ) );
 
 	ctr_first_object = NULL;
-	CtrStdWorld = ctr_internal_create_object(CTR_OBJECT_TYPE_OTOBJECT);
-	CtrStdWorld->info.sticky = 1;
+	ctr_symbol_me = ctr_internal_symbol( ctr_clex_keyword_me, strlen( ctr_clex_keyword_me ), 1 );
+	ctr_symbol_me_icon = ctr_internal_symbol( ctr_clex_keyword_me_icon, strlen( ctr_clex_keyword_me_icon ), 1 );
+	ctr_symbol_this_block = ctr_internal_symbol( "thisBlock", 9, 1 );
+	ctr_symbol_catch = ctr_internal_symbol( "catch", 5, 1 );
+	CtrStdWorld = ctr_internal_create_context();
+	ctr_contexts_size = 32;
+	ctr_contexts = ctr_heap_allocate_tracked( ctr_contexts_size * sizeof( ctr_object* ) );
+	ctr_contexts_tracking_id = ctr_heap_get_latest_tracking_id();
+	ctr_gc_old_objects = NULL;
+	ctr_gc_remembered_size = 64;
+	ctr_gc_remembered_count = 0;
+	ctr_gc_remembered = ctr_heap_allocate_tracked( ctr_gc_remembered_size * sizeof( ctr_object* ) );
+	ctr_gc_remembered_tracking_id = ctr_heap_get_latest_tracking_id();
+	ctr_gc_marking = 0;
+	ctr_gc_young = 0;
+	ctr_gc_max_pause = 0;
+	ctr_gc_gray_size = 64;
+	ctr_gc_gray_count = 0;
+	ctr_gc_step = 0;
+	ctr_gc_gray = ctr_heap_allocate_tracked( ctr_gc_gray_size * sizeof( ctr_gc_frame ) );
+	ctr_gc_gray_tracking_id = ctr_heap_get_latest_tracking_id();
+	ctr_slot_base = ctr_heap_allocate_tracked( ctr_contexts_size * sizeof( ctr_size ) );
+	ctr_slot_base_tracking_id = ctr_heap_get_latest_tracking_id();
+	ctr_context_receivers = ctr_heap_allocate_tracked( ctr_contexts_size * sizeof( ctr_object* ) );
+	ctr_context_receivers_tracking_id = ctr_heap_get_latest_tracking_id();
 	ctr_contexts[0] = CtrStdWorld;
+	ctr_slot_base[0] = 0;
+	ctr_context_receivers[0] = NULL;
+	for(i = 1; i < ctr_contexts_size; i++) {
+		ctr_contexts[i] = ctr_internal_create_context();
+	}
+	ctr_slots_top = 0;
+	ctr_slots_size = 256;
+	ctr_slots = ctr_heap_allocate_tracked( ctr_slots_size * sizeof( ctr_mapitem* ) );
+	ctr_slots_tracking_id = ctr_heap_get_latest_tracking_id();
 
 	/* Object */
 	CtrStdObject = ctr_internal_create_object(CTR_OBJECT_TYPE_OTOBJECT);
@@ -607,6 +1177,12 @@ void ctr_initialize_world() {
 	ctr_internal_object_add_property(CtrStdWorld, ctr_build_string_from_cstring( CTR_DICT_BOOLEAN ), CtrStdBool, 0 );
 	CtrStdBool->link = CtrStdObject;
 	CtrStdBool->info.sticky = 1;
+	CtrStdTrue = ctr_build_bool_box(1);
+	CtrStdTrue->info.sticky = 1;
+	CtrStdTrue->info.shared = 1;
+	CtrStdFalse = ctr_build_bool_box(0);
+	CtrStdFalse->info.sticky = 1;
+	CtrStdFalse->info.shared = 1;
 
 	/* Number */
 	CtrStdNumber = ctr_internal_create_object(CTR_OBJECT_TYPE_OTNUMBER);
@@ -659,6 +1235,8 @@ void ctr_initialize_world() {
 	ctr_internal_object_add_property(CtrStdWorld, ctr_build_string_from_cstring( CTR_DICT_NUMBER ), CtrStdNumber, 0);
 	CtrStdNumber->link = CtrStdObject;
 	CtrStdNumber->info.sticky = 1;
+	ctr_number_initialize_immediates();
+	ctr_number_initialize_ops();
 
 	/* String */
 	CtrStdString = ctr_internal_create_object(CTR_OBJECT_TYPE_OTSTRING);
@@ -840,6 +1418,7 @@ void ctr_initialize_world() {
 	ctr_internal_create_func(CtrStdCommand, ctr_build_string_from_cstring( CTR_DICT_FORBID_INCLUDE ), &ctr_command_forbid_include );
 	ctr_internal_create_func(CtrStdCommand, ctr_build_string_from_cstring( CTR_DICT_FORBID_FORK ), &ctr_command_forbid_fork );
 	ctr_internal_create_func(CtrStdCommand, ctr_build_string_from_cstring( CTR_DICT_SET_REMAINING_MESSAGES ), &ctr_command_countdown );
+	ctr_internal_create_func(CtrStdCommand, ctr_build_string_from_cstring( CTR_DICT_MAX_NESTED_CALLS ), &ctr_command_max_nested_calls );
 	ctr_internal_create_func(CtrStdCommand, ctr_build_string_from_cstring( CTR_DICT_NEW_SET ), &ctr_command_fork );
 	ctr_internal_create_func(CtrStdCommand, ctr_build_string_from_cstring( CTR_DICT_MESSAGE ), &ctr_command_message );
 	ctr_internal_create_func(CtrStdCommand, ctr_build_string_from_cstring( CTR_DICT_LISTEN ), &ctr_command_listen );
@@ -929,6 +1508,7 @@ void ctr_initialize_world() {
 	ctr_internal_create_func(CtrStdGC, ctr_build_string_from_cstring( CTR_DICT_STICKY_COUNT ), &ctr_gc_sticky_count );
 	ctr_internal_create_func(CtrStdGC, ctr_build_string_from_cstring( CTR_DICT_MEMORY_LIMIT ), &ctr_gc_setmemlimit );
 	ctr_internal_create_func(CtrStdGC, ctr_build_string_from_cstring( CTR_DICT_MODE ),  &ctr_gc_setmode );
+	ctr_internal_create_func(CtrStdGC, ctr_build_string_from_cstring( CTR_DICT_MAX_PAUSE ),  &ctr_gc_setmaxpause );
 	ctr_internal_object_add_property(CtrStdWorld, ctr_build_string_from_cstring( CTR_DICT_BROOM ), CtrStdGC, 0 );
 	CtrStdGC->link = CtrStdObject;
 	CtrStdGC->info.sticky = 1;
@@ -964,6 +1544,73 @@ void ctr_initialize_world() {
 	ctr_accept_n_connections = 0;
 }
 
+/**
+ * @internal
+ *
+ * CTRInlineCacheKey
+ *
+ * Returns the object whose method table determines the outcome
+ * of a method lookup on the specified receiver. Objects without
+ * methods of their own behave exactly like their parent.
+ */
+ctr_object* ctr_inline_cache_key(ctr_object* receiverObject) {
+	if (receiverObject->methods->size > 0) return receiverObject;
+	return receiverObject->link;
+}
+
+/**
+ * @internal
+ *
+ * CTRInlineCacheLookup
+ *
+ * Returns the cached method for the specified key or NULL.
+ * A cache belonging to an older method epoch is emptied first.
+ */
+ctr_object* ctr_inline_cache_lookup(ctr_inline_cache* cache, ctr_object* key) {
+	int i;
+	if (cache->epoch != ctr_method_epoch) {
+		for(i = 0; i < CTR_INLINE_CACHE_SIZE; i++) {
+			cache->keys[i] = NULL;
+			cache->methods[i] = NULL;
+		}
+		cache->next = 0;
+		cache->epoch = ctr_method_epoch;
+		return NULL;
+	}
+	for(i = 0; i < CTR_INLINE_CACHE_SIZE; i++) {
+		if (cache->keys[i] == key) return cache->methods[i];
+	}
+	return NULL;
+}
+
+/**
+ * @internal
+ *
+ * CTRInlineCacheStore
+ *
+ * Stores a method in the cache, replacing the oldest entry
+ * if the cache is full.
+ */
+void ctr_inline_cache_store(ctr_inline_cache* cache, ctr_object* key, ctr_object* methodObject) {
+	cache->keys[cache->next] = key;
+	cache->methods[cache->next] = methodObject;
+	cache->next = (cache->next + 1) % CTR_INLINE_CACHE_SIZE;
+}
+
+/**
+ * @internal
+ *
+ * CTRMethodCacheEntry
+ *
+ * Returns the method cache entry for the specified key and
+ * selector. The entry is only valid if its key, selector and
+ * epoch match.
+ */
+ctr_method_cache_entry* ctr_method_cache_entry_for(ctr_object* key, ctr_object* selector) {
+	uintptr_t h = ((uintptr_t) key >> 4) ^ ((uintptr_t) selector >> 3);
+	return &ctr_method_cache[h & (CTR_METHOD_CACHE_SIZE - 1)];
+}
+
 /**
  * @internal
  *
@@ -972,6 +1619,45 @@ void ctr_initialize_world() {
  * Sends a message to a receiver object.
  */
 ctr_object* ctr_send_message(ctr_object* receiverObject, char* message, long vlen, ctr_argument* argumentList) {
+	ctr_object* selector;
+	ctr_object* result;
+	if (CtrStdFlow != NULL) return CtrStdNil;
+	selector = ctr_internal_symbol(message, vlen, 0);
+	if (selector) return ctr_send_message_cached(receiverObject, selector, argumentList, NULL);
+	/* no symbol means no method has this name, respondTo: will handle it */
+	selector = ctr_build_string(message, vlen);
+	selector->info.sticky = 1;
+	result = ctr_send_message_cached(receiverObject, selector, argumentList, NULL);
+	selector->info.sticky = 0;
+	return result;
+}
+
+/**
+ * @internal
+ *
+ * CTRMessageSendCached
+ *
+ * Sends a message to a receiver object, if a cache is
+ * specified the method lookup is skipped for receivers that
+ * have been seen before by the same call site.
+ */
+ctr_object* ctr_send_message_cached(ctr_object* receiverObject, ctr_object* selector, ctr_argument* argumentList, ctr_inline_cache* cache) {
+	return ctr_send_message_dispatch(receiverObject, selector, argumentList, cache, 0);
+}
+
+/**
+ * @internal
+ *
+ * CTRMessageSendDispatch
+ *
+ * Looks up and invokes the method for a message. If tail is set
+ * the message is the returned expression of a block run by
+ * ctr_block_run, a method that is a block is then not run here but
+ * handed back to ctr_block_run as a tail call (ctr_block_tail_call).
+ */
+ctr_object* ctr_send_message_dispatch(ctr_object* receiverObject, ctr_object* selector, ctr_argument* argumentList, ctr_inline_cache* cache, int tail) {
+	char* message = selector->value.svalue->value;
+	long vlen = selector->value.svalue->vlen;
 	char toParent = 0;
 	int  i = 0;
 	char messageApproved = 0;
@@ -980,10 +1666,12 @@ ctr_object* ctr_send_message(ctr_object* receiverObject, char* message, long vle
 	ctr_object* searchObject;
 	ctr_object* returnValue;
 	ctr_argument* argCounter;
-	ctr_argument* mesgArgument;
+	ctr_argument mesgArgument;
 	ctr_object* result;
 	ctr_object* (*funct)(ctr_object* receiverObject, ctr_argument* argumentList);
 	ctr_object* msg = NULL;
+	ctr_object* cacheKey = NULL;
+	ctr_method_cache_entry* entry;
 	int argCount;
 	if (CtrStdFlow != NULL) return CtrStdNil; /* Error mode, ignore subsequent messages until resolved. */
 	if ( ctr_command_security_profile & CTR_SECPRO_COUNTDOWN ) {
@@ -996,21 +1684,47 @@ ctr_object* ctr_send_message(ctr_object* receiverObject, char* message, long vle
 	methodObject = NULL;
 	searchObject = receiverObject;
 	if (vlen > 1 && message[0] == '`') {
-		me = ctr_internal_object_find_property(ctr_contexts[ctr_context_id], ctr_build_string_from_cstring( ctr_clex_keyword_me ), 0);
+		me = ctr_context_receivers[ctr_context_id];
 		if (searchObject == me) {
 			toParent = 1;
 			message = message + 1;
 			vlen--;
+			selector = ctr_internal_symbol(message, vlen, 0);
+			if (!selector) {
+				msg = ctr_build_string(message, vlen);
+				msg->info.sticky = 1; /* prevent message from being swept, no need to free(), GC will do */
+				selector = msg;
+			}
 		}
 	}
-	msg = ctr_build_string(message, vlen);
-	msg->info.sticky = 1; /* prevent message from being swept, no need to free(), GC will do */
-	while(!methodObject) {
-		methodObject = ctr_internal_object_find_property(searchObject, msg, 1);
-		if (methodObject && toParent) { toParent = 0; methodObject = NULL; }
-		if (methodObject) break;
-		if (!searchObject->link) break;
-		searchObject = searchObject->link;
+	if (!toParent) {
+		cacheKey = ctr_inline_cache_key(receiverObject);
+		if (cache && cacheKey) methodObject = ctr_inline_cache_lookup(cache, cacheKey);
+	}
+	if (!methodObject) {
+		entry = NULL;
+		/* only interned selectors outlive the lookup */
+		if (cacheKey && selector->info.interned) {
+			entry = ctr_method_cache_entry_for(cacheKey, selector);
+		}
+		if (entry && entry->epoch == ctr_method_epoch && entry->key == cacheKey && entry->selector == selector) {
+			methodObject = entry->method;
+		} else {
+			while(!methodObject) {
+				methodObject = ctr_internal_object_find_property(searchObject, selector, 1);
+				if (methodObject && toParent) { toParent = 0; methodObject = NULL; }
+				if (methodObject) break;
+				if (!searchObject->link) break;
+				searchObject = searchObject->link;
+			}
+			if (entry) {
+				entry->epoch = ctr_method_epoch;
+				entry->key = cacheKey;
+				entry->selector = selector;
+				entry->method = methodObject;
+			}
+		}
+		if (methodObject && cache && cacheKey) ctr_inline_cache_store(cache, cacheKey, methodObject);
 	}
 	if (!methodObject) {
 		argCounter = argumentList;
@@ -1019,18 +1733,16 @@ ctr_object* ctr_send_message(ctr_object* receiverObject, char* message, long vle
 			argCounter = argCounter->next;
 			argCount ++;
 		}
-		mesgArgument = (ctr_argument*) ctr_heap_allocate( sizeof( ctr_argument ) );
-		mesgArgument->object = ctr_build_string(message, vlen);
-		mesgArgument->next = argumentList;
+		mesgArgument.object = ctr_build_string(message, vlen);
+		mesgArgument.next = argumentList;
 		if (argCount == 0 || argCount > 2) {
-			returnValue = ctr_send_message(receiverObject, CTR_DICT_RESPOND_TO, strlen(CTR_DICT_RESPOND_TO),  mesgArgument);
+			returnValue = ctr_send_message(receiverObject, CTR_DICT_RESPOND_TO, strlen(CTR_DICT_RESPOND_TO),  &mesgArgument);
 		} else if (argCount == 1) {
-			returnValue = ctr_send_message(receiverObject, CTR_DICT_RESPOND_TO_AND, strlen(CTR_DICT_RESPOND_TO_AND),  mesgArgument);
+			returnValue = ctr_send_message(receiverObject, CTR_DICT_RESPOND_TO_AND, strlen(CTR_DICT_RESPOND_TO_AND),  &mesgArgument);
 		} else if (argCount == 2) {
-			returnValue = ctr_send_message(receiverObject, CTR_DICT_RESPOND_TO_AND_AND, strlen(CTR_DICT_RESPOND_TO_AND_AND),  mesgArgument);
+			returnValue = ctr_send_message(receiverObject, CTR_DICT_RESPOND_TO_AND_AND, strlen(CTR_DICT_RESPOND_TO_AND_AND),  &mesgArgument);
 		}
-		ctr_heap_free( mesgArgument );
-		msg->info.sticky = 0;
+		if (msg) msg->info.sticky = 0;
 		if (receiverObject->info.chainMode == 1) return receiverObject;
 		return returnValue;
 	}
@@ -1045,7 +1757,7 @@ ctr_object* ctr_send_message(ctr_object* receiverObject, char* message, long vle
 				}
 			}
 			if ( !messageApproved ) {
-				printf( "Native message not allowed in eval %s.\n", msg->value.svalue->value );
+				printf( "Native message not allowed in eval %.*s.\n", (int) vlen, message );
 				exit(1);
 			}
 		}
@@ -1056,7 +1768,11 @@ ctr_object* ctr_send_message(ctr_object* receiverObject, char* message, long vle
 			printf( "Custom message not allowed in eval.\n" );
 			exit(1);
 		}
-		result = ctr_block_run(methodObject, argumentList, receiverObject);
+		if (tail && receiverObject->info.chainMode != 1) {
+			result = ctr_block_tail_call(methodObject, argumentList, receiverObject);
+		} else {
+			result = ctr_block_run(methodObject, argumentList, receiverObject);
+		}
 	}
 	if (msg) msg->info.sticky = 0;
 	if (receiverObject->info.chainMode == 1) return receiverObject;
@@ -1067,23 +1783,24 @@ ctr_object* ctr_send_message(ctr_object* receiverObject, char* message, long vle
 /**
  * @internal
  *
- * CTRValueAssignment
+ * CTRCopyOnAssign
  *
- * Assigns a value to a variable in the current context.
+ * Returns the value to store when assigning an object to a
+ * variable or property. Booleans, numbers and strings are
+ * copied (strings share their bytes until one of them changes),
+ * all other objects are assigned by reference.
  */
-ctr_object* ctr_assign_value(ctr_object* key, ctr_object* o) {
+ctr_object* ctr_internal_copy_on_assign(ctr_object* o) {
 	ctr_object* object = NULL;
-	if (CtrStdFlow) return CtrStdNil;
-	key->info.sticky = 0;
 	switch(o->info.type){
 		case CTR_OBJECT_TYPE_OTBOOL:
-			object = ctr_build_bool(o->value.bvalue);
+			object = ctr_build_bool_box(o->value.bvalue);
 			break;
 		case CTR_OBJECT_TYPE_OTNUMBER:
-			object = ctr_build_number_from_float(o->value.nvalue);
+			object = ctr_build_number_box(o->value.nvalue);
 			break;
 		case CTR_OBJECT_TYPE_OTSTRING:
-			object = ctr_build_string(o->value.svalue->value, o->value.svalue->vlen);
+			object = ctr_build_string_shared(o);
 			break;
 		case CTR_OBJECT_TYPE_OTNIL:
 		case CTR_OBJECT_TYPE_OTNATFUNC:
@@ -1095,6 +1812,67 @@ ctr_object* ctr_assign_value(ctr_object* key, ctr_object* o) {
 			object = o;
 			break;
 	}
+	return object;
+}
+
+/**
+ * @internal
+ *
+ * CTRUnshare
+ *
+ * Returns a private copy of a shared object (like the small
+ * integers, True and False), or the object itself if it is
+ * not shared.
+ */
+ctr_object* ctr_internal_unshare(ctr_object* o) {
+	if (!o->info.shared) return o;
+	return ctr_internal_copy_on_assign(o);
+}
+
+/**
+ * @internal
+ *
+ * ArgumentVector
+ *
+ * Returns count arguments (Nil) stored next to each other, each
+ * one linking to the next. Uses the buffer (of size items) if it
+ * has room, otherwise allocates the vector on the heap.
+ */
+ctr_argument* ctr_argument_vector(ctr_argument* buffer, int size, int count) {
+	ctr_argument* vector = buffer;
+	int i;
+	if (count > size) {
+		vector = (ctr_argument*) ctr_heap_allocate( count * sizeof( ctr_argument ) );
+	}
+	for(i = 0; i < count; i++) {
+		vector[i].object = CtrStdNil;
+		vector[i].next = (i + 1 < count) ? vector + i + 1 : NULL;
+	}
+	return vector;
+}
+
+/**
+ * @internal
+ *
+ * ArgumentVectorFree
+ *
+ * Frees an argument vector unless it lives in the buffer.
+ */
+void ctr_argument_vector_free(ctr_argument* buffer, ctr_argument* vector) {
+	if (vector != buffer) ctr_heap_free( vector );
+}
+
+/**
+ * @internal
+ *
+ * CTRValueAssignment
+ *
+ * Assigns a value to a variable in the current context.
+ */
+ctr_object* ctr_assign_value(ctr_object* key, ctr_object* o) {
+	ctr_object* object = NULL;
+	if (CtrStdFlow) return CtrStdNil;
+	object = ctr_internal_copy_on_assign(o);
 	ctr_set(key, object);
 	return object;
 }
@@ -1105,32 +1883,21 @@ ctr_object* ctr_assign_value(ctr_object* key, ctr_object* o) {
  *
  * CTRAssignValueObject
  *
- * Assigns a value to a property of an object.
+ * Assigns a value to a property of an object, like
+ * ctr_find_in_my a site makes use of the shape of the object.
  */
-ctr_object* ctr_assign_value_to_my(ctr_object* key, ctr_object* o) {
+ctr_object* ctr_assign_value_to_my(ctr_object* key, ctr_object* o, ctr_tnode* site) {
 	ctr_object* object = NULL;
-	ctr_object* my = ctr_find(ctr_build_string_from_cstring( ctr_clex_keyword_me ) );
+	ctr_object* my = ctr_find_me();
+	ctr_mapitem* item;
 	if (CtrStdFlow) return CtrStdNil;
-	key->info.sticky = 0;
-	switch(o->info.type){
-		case CTR_OBJECT_TYPE_OTBOOL:
-			object = ctr_build_bool(o->value.bvalue);
-			break;
-		case CTR_OBJECT_TYPE_OTNUMBER:
-			object = ctr_build_number_from_float(o->value.nvalue);
-			break;
-		case CTR_OBJECT_TYPE_OTSTRING:
-			object = ctr_build_string(o->value.svalue->value, o->value.svalue->vlen);
-			break;
-		case CTR_OBJECT_TYPE_OTNIL:
-		case CTR_OBJECT_TYPE_OTNATFUNC:
-		case CTR_OBJECT_TYPE_OTOBJECT:
-		case CTR_OBJECT_TYPE_OTEX:
-		case CTR_OBJECT_TYPE_OTMISC:
-		case CTR_OBJECT_TYPE_OTARRAY:
-		case CTR_OBJECT_TYPE_OTBLOCK:
-			object = o;
-			break;
+	if (my->info.shared) my = ctr_unshare_me();
+	object = ctr_internal_copy_on_assign(o);
+	item = site ? ctr_internal_shape_lookup(my->properties, key, site) : NULL;
+	if (item) {
+		item->value = ctr_internal_unshare(object);
+		ctr_gc_write_barrier(my, item->value);
+		return object;
 	}
 	ctr_internal_object_set_property(my, key, object, 0);
 	return object;
@@ -1148,27 +1915,7 @@ ctr_object* ctr_assign_value_to_local(ctr_object* key, ctr_object* o) {
 	ctr_object* context;
 	if (CtrStdFlow) return CtrStdNil;
 	context = ctr_contexts[ctr_context_id];
-	key->info.sticky = 0;
-	switch(o->info.type){
-		case CTR_OBJECT_TYPE_OTBOOL:
-			object = ctr_build_bool(o->value.bvalue);
-			break;
-		case CTR_OBJECT_TYPE_OTNUMBER:
-			object = ctr_build_number_from_float(o->value.nvalue);
-			break;
-		case CTR_OBJECT_TYPE_OTSTRING:
-			object = ctr_build_string(o->value.svalue->value, o->value.svalue->vlen);
-			break;
-		case CTR_OBJECT_TYPE_OTNIL:
-		case CTR_OBJECT_TYPE_OTNATFUNC:
-		case CTR_OBJECT_TYPE_OTOBJECT:
-		case CTR_OBJECT_TYPE_OTEX:
-		case CTR_OBJECT_TYPE_OTMISC:
-		case CTR_OBJECT_TYPE_OTARRAY:
-		case CTR_OBJECT_TYPE_OTBLOCK:
-			object = o;
-			break;
-	}
+	object = ctr_internal_copy_on_assign(o);
 	ctr_internal_object_set_property(context, key, object, 0);
 	return object;
 }
@@ -1186,8 +1933,63 @@ ctr_object* ctr_assign_value_to_local_by_ref(ctr_object* key, ctr_object* o) {
 	ctr_object* context;
 	if (CtrStdFlow) return CtrStdNil;
 	context = ctr_contexts[ctr_context_id];
-	key->info.sticky = 0;
 	object = o;
 	ctr_internal_object_set_property(context, key, object, 0);
 	return object;
 }
+
+/**
+ * @internal
+ *
+ * CTRAssignValueSlot
+ *
+ * Assigns a value to a local variable using its slot in the
+ * current context. If declare is set the variable is created in
+ * the current context (var), otherwise an existing variable is
+ * updated. Without a filled slot this falls back to assignment
+ * by name.
+ */
+ctr_object* ctr_assign_value_to_slot(ctr_object* key, ctr_object* o, int slot, int declare) {
+	ctr_object* object;
+	ctr_size index;
+	if (CtrStdFlow) return CtrStdNil;
+	index = ctr_slot_base[ctr_context_id] + slot - 1;
+	if (slot == 0 || index >= ctr_slots_top) {
+		if (declare) return ctr_assign_value_to_local(key, o);
+		return ctr_assign_value(key, o);
+	}
+	if (ctr_slots[index]) {
+		object = ctr_internal_copy_on_assign(o);
+		ctr_slots[index]->value = object;
+		return object;
+	}
+	if (!declare) return ctr_assign_value(key, o);
+	object = ctr_assign_value_to_local(key, o);
+	/* the item of a variable that has just been set is always in front */
+	if (!CtrStdFlow) ctr_slots[index] = ctr_contexts[ctr_context_id]->properties->head;
+	return object;
+}
+
+/**
+ * @internal
+ *
+ * CTRAssignValueSlotByRef
+ *
+ * Declares a local variable in the current context using its slot
+ * and assigns the object itself to it, even if it is shared.
+ */
+ctr_object* ctr_assign_value_to_slot_by_ref(ctr_object* key, ctr_object* o, int slot) {
+	ctr_size index;
+	if (CtrStdFlow) return CtrStdNil;
+	index = ctr_slot_base[ctr_context_id] + slot - 1;
+	if (slot == 0 || index >= ctr_slots_top) {
+		return ctr_assign_value_to_local_by_ref(key, o);
+	}
+	if (!ctr_slots[index]) {
+		ctr_assign_value_to_local_by_ref(key, o);
+		if (CtrStdFlow) return CtrStdNil;
+		ctr_slots[index] = ctr_contexts[ctr_context_id]->properties->head;
+	}
+	ctr_slots[index]->value = o;
+	return o;
+}